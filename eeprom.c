@@ -34,137 +34,368 @@
 /* Includes ------------------------------------------------------------------*/
 
 #include "eeprom.h"
-#include "eeprom_STM32.h"
+#include <string.h>
+#include "eeprom_format.h"
 
 /* Macros --------------------------------------------------------------------*/
 
-#if !defined(EEPROM_PAGE0_ADDRESS) || !defined(EEPROM_PAGE0_NUM) || !defined(EEPROM_PAGE_SIZE) || !defined(EEPROM_VAR_NUM)
-#error "EEPROM_PAGE0_ADDRESS, EEPROM_PAGE0_NUM and EEPROM_PAGE_SIZE must be defined!"
+#ifndef EEPROM_VAR_NUM
+#error "EEPROM_VAR_NUM must be defined!"
 #endif
 
-/* Calculation of Page 1 characteristics if not explicitly defined */
-#ifndef EEPROM_PAGE1_OFFSET
-#define EEPROM_PAGE1_OFFSET ((uint32_t)1)
+#define EEPROM_PAGE0          ((uint32_t)0)
+#define EEPROM_PAGE1          ((uint32_t)1)
+
+/* Page geometry of the selected flash backend */
+#define BACKEND_PAGE0_ADDRESS (EEPROM_backend->pageAddress[EEPROM_PAGE0])
+#define BACKEND_PAGE1_ADDRESS (EEPROM_backend->pageAddress[EEPROM_PAGE1])
+#define BACKEND_PAGE_SIZE     (EEPROM_backend->pageSize)
+
+#define OP_READ_VALID_PAGE    ((uint8_t)0x00)
+#define OP_WRITE_VALID_PAGE   ((uint8_t)0x01)
+
+#define EEPROM_NO_VALID_PAGE  ((uint16_t)0x00AB)
+
+#ifdef EEPROM_LAZY_INIT
+#define EEPROM_IS_PAGE_STATUS(status)                                                                                  \
+    (((status) == EEPROM_PAGE_CLEARED) || ((status) == EEPROM_PAGE_ACTIVE) || ((status) == EEPROM_PAGE_RECEIVING))
+#endif
+
+#ifdef EEPROM_LAYOUT_SLOTS
+/* Region of a variable in the page starting at pageAddress */
+#define EEPROM_SLOT_ADDRESS(pageAddress, virtAddress) ((pageAddress) + EEPROM_SLOT_OFFSET(BACKEND_PAGE_SIZE, EEPROM_VAR_NUM, (virtAddress)))
+#define EEPROM_SLOT_SIZE                              (EEPROM_SLOT_RECORDS(BACKEND_PAGE_SIZE, EEPROM_VAR_NUM) * EEPROM_RECORD_SIZE)
 #endif
 
-#ifndef EEPROM_PAGE1_ADDRESS
-#define EEPROM_PAGE1_ADDRESS ((uint32_t)EEPROM_PAGE0_ADDRESS + EEPROM_PAGE1_OFFSET * EEPROM_PAGE_SIZE)
+#ifdef EEPROM_LOW_RAM
+#ifndef EEPROM_TAIL_VERIFY_SLOTS
+#define EEPROM_TAIL_VERIFY_SLOTS ((uint32_t)4)
 #endif
 
-#ifndef EEPROM_PAGE1_NUM
-#define EEPROM_PAGE1_NUM (EEPROM_PAGE0_NUM + EEPROM_PAGE1_OFFSET)
+/* "Ever written" map access, one bit per variable */
+#define EEPROM_MAP_SET(virtAddress) (EEPROM_writtenMap[(virtAddress) >> 3] |= (uint8_t)(1U << ((virtAddress) & 7U)))
+#define EEPROM_MAP_GET(virtAddress) (EEPROM_writtenMap[(virtAddress) >> 3] & (uint8_t)(1U << ((virtAddress) & 7U)))
 #endif
 
-/* Memory erase struct definition */
+#ifdef EEPROM_TRACE
+#ifndef EEPROM_TRACE_SIZE
+/* Default: 768 bytes of RAM. A whole page transfer needs up to 9 * EEPROM_VAR_NUM + 16 events */
+#define EEPROM_TRACE_SIZE 64U
+#endif
+#if (EEPROM_TRACE_SIZE & (EEPROM_TRACE_SIZE - 1U)) != 0
+#error "EEPROM_TRACE_SIZE must be a power of 2!"
+#endif
 
-#ifdef FLASH_VOLTAGE_RANGE_3
-#define FLASH_ERASE_SET_VOLTAGE() (pEraseInit.VoltageRange = FLASH_VOLTAGE_RANGE_3)
+/* Default timestamp: DWT cycle counter where available, SysTick milliseconds otherwise */
+#ifndef EEPROM_TRACE_TIMESTAMP
+#if defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+#define EEPROM_TRACE_TIMESTAMP() (DWT->CYCCNT)
+#define EEPROM_TRACE_USE_DWT
+#elif EEPROM_USE_STM32_BACKEND
+#define EEPROM_TRACE_TIMESTAMP() HAL_GetTick()
 #else
-#define FLASH_ERASE_SET_VOLTAGE() /* No action */
-#endif
-
-#if EEPROM_ERASE == EEPROM_ERASE_PAGE_ADDRESS
-#define EEPROM_PAGE0_ID EEPROM_PAGE0_ADDRESS
-#define EEPROM_PAGE1_ID EEPROM_PAGE1_ADDRESS
-#define FLASH_ERASE_INIT(address)                                                                                                                              \
-    do {                                                                                                                                                       \
-        pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;                                                                                                          \
-        pEraseInit.PageAddress = address;                                                                                                                      \
-        pEraseInit.NbPages = 1;                                                                                                                                \
-        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
-    } while (0)
-#elif EEPROM_ERASE == EEPROM_ERASE_PAGE_NUMBER
-#define EEPROM_PAGE0_ID EEPROM_PAGE0_NUM
-#define EEPROM_PAGE1_ID EEPROM_PAGE1_NUM
-#define FLASH_ERASE_INIT(address)                                                                                                                              \
-    do {                                                                                                                                                       \
-        pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;                                                                                                          \
-        pEraseInit.Page = address;                                                                                                                             \
-        pEraseInit.NbPages = 1;                                                                                                                                \
-        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
-    } while (0)
-#else /* EEPROM_ERASE == EEPROM_ERASE_SECTOR_NUMBER */
-#define EEPROM_PAGE0_ID EEPROM_PAGE0_NUM
-#define EEPROM_PAGE1_ID EEPROM_PAGE1_NUM
-#define FLASH_ERASE_INIT(address)                                                                                                                              \
-    do {                                                                                                                                                       \
-        pEraseInit.TypeErase = FLASH_TYPEERASE_SECTORS;                                                                                                        \
-        pEraseInit.Sector = address;                                                                                                                           \
-        pEraseInit.NbSectors = 1;                                                                                                                              \
-        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
-    } while (0)
-#endif
-
-#define FLASH_READ(address)   (*(__IO uint16_t*)(address))
-#define FLASH_READ32(address) (*(__IO uint32_t*)(address))
+#error "EEPROM_TRACE_TIMESTAMP() must be defined when the STM32 backend is disabled!"
+#endif
+#endif
 
-#define OP_READ_VALID_PAGE    ((uint8_t)0x00)
-#define OP_WRITE_VALID_PAGE   ((uint8_t)0x01)
+#define EEPROM_TRACE_EVENT(type, arg) EEPROM_TraceEvent((type), (uint32_t)(arg))
+#else
+#define EEPROM_TRACE_EVENT(type, arg) /* No action */
+#endif
 
-#define EEPROM_NO_VALID_PAGE  ((uint16_t)0x00AB)
+#ifdef EEPROM_ISR_QUEUE_SIZE
+#if (EEPROM_ISR_QUEUE_SIZE == 0) || ((EEPROM_ISR_QUEUE_SIZE & (EEPROM_ISR_QUEUE_SIZE - 1U)) != 0)
+#error "EEPROM_ISR_QUEUE_SIZE must be a power of 2!"
+#endif
 
-#define EEPROM_PAGE_CLEARED   ((uint16_t)0xFFFF)
-#define EEPROM_PAGE_ACTIVE    ((uint16_t)0x0000)
-#define EEPROM_PAGE_RECEIVING ((uint16_t)0xEEEE)
+/* Queue entries pack virtual address and value, so that each of them is written with a single store */
+#define EEPROM_QUEUE_ENTRY(virtAddress, value) (((uint32_t)(virtAddress) << 16) | (uint32_t)(value))
+#define EEPROM_QUEUE_ADDRESS(entry)            ((uint16_t)((entry) >> 16))
+#define EEPROM_QUEUE_VALUE(entry)              ((uint16_t)((entry) & 0xFFFFU))
+
+/* Entry ii of the batch being drained: copied in overwrite mode, read in place otherwise since the producer cannot
+   touch the slots between tail and head */
+#ifdef EEPROM_ISR_QUEUE_OVERWRITE
+#define EEPROM_QUEUE_BATCH(tail, ii) (EEPROM_queueBatch[(ii)])
+#else
+#define EEPROM_QUEUE_BATCH(tail, ii) (EEPROM_queueBuffer[((tail) + (ii)) & (EEPROM_ISR_QUEUE_SIZE - 1U)])
+#endif
+
+/* Coalescing maps: addresses met in the batch, one bit per variable, and batch entries to be written */
+#define EEPROM_QUEUE_SEEN_SET(virtAddress) (EEPROM_queueSeen[(virtAddress) >> 3] |= (uint8_t)(1U << ((virtAddress) & 7U)))
+#define EEPROM_QUEUE_SEEN_GET(virtAddress) (EEPROM_queueSeen[(virtAddress) >> 3] & (uint8_t)(1U << ((virtAddress) & 7U)))
+#define EEPROM_QUEUE_LAST_SET(ii)          (EEPROM_queueLast[(ii) >> 3] |= (uint8_t)(1U << ((ii) & 7U)))
+#define EEPROM_QUEUE_LAST_GET(ii)          (EEPROM_queueLast[(ii) >> 3] & (uint8_t)(1U << ((ii) & 7U)))
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+#if EEPROM_USE_STM32_BACKEND
+static const EEPROM_backend_t* EEPROM_backend = &EEPROM_backendSTM32;
+#else
+static const EEPROM_backend_t* EEPROM_backend = NULL;
+#endif
+/* Copy of the backend mapping, read on every flash access */
+static uint8_t EEPROM_isMapped = EEPROM_USE_STM32_BACKEND;
+static uintptr_t EEPROM_mapOffset = 0;
+/* XOR mask turning backend data into the 0xFF-blank logical format */
+static uint32_t EEPROM_blankInvert = 0;
+static volatile uint32_t EEPROM_generation = 0;
+/* Failed backend reads: operations compare it before and after reading, so that no decision is taken on bad data */
+static uint32_t EEPROM_readErrors = 0;
+
+#ifdef EEPROM_LAZY_INIT
+/* Set by EEPROM_Init when the repair of the page states is deferred */
+static uint8_t EEPROM_recoveryPending = 0;
+#endif
+
+#ifdef EEPROM_LOW_RAM
+static uint8_t EEPROM_writtenMap[(EEPROM_VAR_NUM + 7U) / 8U];
+/* Cleared until EEPROM_Init builds the map from readable pages: a partial map would hide variables from page transfers */
+static uint8_t EEPROM_mapValid = 0;
+#endif
+
+#ifdef EEPROM_TRACE
+/* Trace ring buffer: the producer only advances the head, the reader detects overwritten events on its own */
+static volatile EEPROM_traceEvent_t EEPROM_traceBuffer[EEPROM_TRACE_SIZE];
+static volatile uint32_t EEPROM_traceHead = 0;
+static uint32_t EEPROM_traceTail = 0;
+static uint32_t EEPROM_traceLost = 0;
+#endif
+
+#ifdef EEPROM_ISR_QUEUE_SIZE
+/* ISR write queue: the producer only advances the head, the consumer only advances the tail */
+static volatile uint32_t EEPROM_queueBuffer[EEPROM_ISR_QUEUE_SIZE];
+static volatile uint32_t EEPROM_queueHead = 0;
+static volatile uint32_t EEPROM_queueTail = 0;
+/* Written by the producer when dropping new entries, by the consumer when detecting overwritten ones */
+static volatile uint32_t EEPROM_queueOverflow = 0;
+#ifdef EEPROM_ISR_QUEUE_OVERWRITE
+static uint32_t EEPROM_queueBatch[EEPROM_ISR_QUEUE_SIZE];
+#endif
+static uint8_t EEPROM_queueSeen[(EEPROM_VAR_NUM + 7U) / 8U];
+static uint8_t EEPROM_queueLast[(EEPROM_ISR_QUEUE_SIZE + 7U) / 8U];
+#endif
 
 /* Private functions ---------------------------------------------------------*/
+#ifdef EEPROM_TRACE
+static void EEPROM_TraceEvent(uint8_t type, uint32_t arg) {
+    uint32_t head = EEPROM_traceHead;
+    volatile EEPROM_traceEvent_t* event = &EEPROM_traceBuffer[head & (EEPROM_TRACE_SIZE - 1U)];
+
+    /* Fill the slot before publishing it, volatile accesses keep the order on a single core */
+    event->timestamp = EEPROM_TRACE_TIMESTAMP();
+    event->arg = arg;
+    event->type = type;
+    EEPROM_traceHead = head + 1U;
+}
+#endif
+
+static uint16_t EEPROM_Read16(uint32_t address) {
+    uint16_t value = 0;
+
+    if (EEPROM_isMapped) {
+        value = *(volatile const uint16_t*)(EEPROM_mapOffset + address);
+    } else if (EEPROM_backend->read(address, &value, sizeof(value)) != EEPROM_SUCCESS) {
+        EEPROM_readErrors++;
+    }
+    return (uint16_t)(value ^ EEPROM_blankInvert);
+}
+
+static uint32_t EEPROM_Read32(uint32_t address) {
+    uint32_t value = 0;
+
+    if (EEPROM_isMapped) {
+        value = *(volatile const uint32_t*)(EEPROM_mapOffset + address);
+    } else if (EEPROM_backend->read(address, &value, sizeof(value)) != EEPROM_SUCCESS) {
+        EEPROM_readErrors++;
+    }
+    return value ^ EEPROM_blankInvert;
+}
+
+static EEPROM_retStatus_t EEPROM_FlashProgram(uint32_t address, uint16_t data) {
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_PROGRAM_START, address);
+    flashStatus = EEPROM_backend->program(address, (uint16_t)(data ^ EEPROM_blankInvert));
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_PROGRAM_END, flashStatus);
+    return flashStatus;
+}
+
+static EEPROM_retStatus_t EEPROM_FlashErase(uint32_t page) {
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
+
+    /* Pointers returned by EEPROM_GetConstPtr() may point into this page */
+    EEPROM_generation++;
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_ERASE_START, EEPROM_backend->pageAddress[page]);
+    flashStatus = EEPROM_backend->erase(EEPROM_backend->pageAddress[page]);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_ERASE_END, flashStatus);
+    return flashStatus;
+}
+
+#ifdef EEPROM_LOW_RAM
+#ifndef EEPROM_LAYOUT_SLOTS
+static uint32_t EEPROM_FindTail(uint32_t pageAddress) {
+    uint32_t low = 1U, high = EEPROM_PAGE_RECORDS(BACKEND_PAGE_SIZE), mid = 0, check = 0, verifyEnd = 0;
+
+    while (1) {
+        /* Bisect for the first blank record: the log is append-only, so written records form a prefix of the page */
+        while (low < high) {
+            mid = low + ((high - low) >> 1);
+            if (EEPROM_Read32(pageAddress + mid * EEPROM_RECORD_SIZE) == EEPROM_RECORD_BLANK) {
+                high = mid;
+            } else {
+                low = mid + 1U;
+            }
+        }
+
+        /* Verify that the next few records are blank too, otherwise resume the search past the written one */
+        verifyEnd = low + 1U + EEPROM_TAIL_VERIFY_SLOTS;
+        if (verifyEnd > EEPROM_PAGE_RECORDS(BACKEND_PAGE_SIZE)) {
+            verifyEnd = EEPROM_PAGE_RECORDS(BACKEND_PAGE_SIZE);
+        }
+        for (check = low + 1U; check < verifyEnd; check++) {
+            if (EEPROM_Read32(pageAddress + check * EEPROM_RECORD_SIZE) != EEPROM_RECORD_BLANK) {
+                break;
+            }
+        }
+        if (check >= verifyEnd) {
+            return pageAddress + low * EEPROM_RECORD_SIZE;
+        }
+        low = check + 1U;
+        high = EEPROM_PAGE_RECORDS(BACKEND_PAGE_SIZE);
+    }
+}
+#endif
+
+static void EEPROM_BuildWrittenMap(void) {
+    uint32_t pageAddress[2] = {BACKEND_PAGE0_ADDRESS, BACKEND_PAGE1_ADDRESS};
+#ifdef EEPROM_LAYOUT_SLOTS
+    uint16_t pageStatus = 0, jj = 0, ii = 0;
+#else
+    uint32_t address = 0, endAddress = 0;
+    uint16_t pageStatus = 0, addressValue = 0, found = 0, ii = 0;
+#endif
+
+    memset(EEPROM_writtenMap, 0, sizeof(EEPROM_writtenMap));
+
+    /* Both an active and a receiving page may hold variables that survive recovery */
+    for (ii = 0; ii < 2; ii++) {
+        pageStatus = EEPROM_Read16(pageAddress[ii]);
+        if ((pageStatus != EEPROM_PAGE_ACTIVE) && (pageStatus != EEPROM_PAGE_RECEIVING)) {
+            continue;
+        }
+        EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_START, pageAddress[ii]);
+#ifdef EEPROM_LAYOUT_SLOTS
+        /* A variable has been written if its region is not empty */
+        for (jj = 0; jj < EEPROM_VAR_NUM; jj++) {
+            if (EEPROM_Read32(EEPROM_SLOT_ADDRESS(pageAddress[ii], jj)) != EEPROM_RECORD_BLANK) {
+                EEPROM_MAP_SET(jj);
+            }
+        }
+        EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, pageAddress[ii] + BACKEND_PAGE_SIZE);
+#else
+        endAddress = EEPROM_FindTail(pageAddress[ii]);
+        for (address = pageAddress[ii] + EEPROM_FIRST_RECORD_OFFSET; address < endAddress; address += EEPROM_RECORD_SIZE) {
+            addressValue = EEPROM_Read16(address + EEPROM_RECORD_ADDRESS_OFFSET);
+            if ((addressValue < EEPROM_VAR_NUM) && !EEPROM_MAP_GET(addressValue)) {
+                EEPROM_MAP_SET(addressValue);
+                /* Stop as soon as every variable has been seen */
+                if (++found == EEPROM_VAR_NUM) {
+                    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+                    return;
+                }
+            }
+        }
+        EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+#endif
+    }
+}
+#endif
+
 static EEPROM_retStatus_t EEPROM_IsPageErased(uint32_t address) {
     uint32_t endAddress;
     uint16_t addressValue = 0x5555;
 
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_START, address);
     /* Compute page end-address */
-    endAddress = (uint32_t)(address + (EEPROM_PAGE_SIZE - 4U));
+    endAddress = (uint32_t)(address + (BACKEND_PAGE_SIZE - 4U));
     /* Check each active page address starting from end */
     while (address <= endAddress) {
         /* Get the current location content to be compared with virtual address */
-        addressValue = FLASH_READ(address);
+        addressValue = EEPROM_Read16(address);
         /* Compare the read address with the virtual address */
         if (addressValue != EEPROM_PAGE_CLEARED) {
             /* In case variable value is read, return error */
+            EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, EEPROM_ERROR);
             return EEPROM_ERROR;
         }
         /* Next address location */
         address += 4;
     }
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, EEPROM_SUCCESS);
     return EEPROM_SUCCESS;
 }
 
+static uint8_t EEPROM_IsTransferred(uint32_t pageAddress, uint16_t virtAddress) {
+#ifdef EEPROM_LAYOUT_SLOTS
+    /* The first record of the region is complete once its virtual address is programmed */
+    return (uint8_t)(EEPROM_Read16(EEPROM_SLOT_ADDRESS(pageAddress, virtAddress) + EEPROM_RECORD_ADDRESS_OFFSET) == virtAddress);
+#else
+    uint32_t address = pageAddress + EEPROM_FIRST_RECORD_OFFSET, endAddress = pageAddress + BACKEND_PAGE_SIZE;
+
+    /* A receiving page only holds the records copied so far, from its start and at most one per variable */
+    while ((address < endAddress) && (EEPROM_Read32(address) != EEPROM_RECORD_BLANK)) {
+        if (EEPROM_Read16(address + EEPROM_RECORD_ADDRESS_OFFSET) == virtAddress) {
+            return 1;
+        }
+        address += EEPROM_RECORD_SIZE;
+    }
+    return 0;
+#endif
+}
+
+static EEPROM_retStatus_t EEPROM_ErasePageIfNeeded(uint32_t page) {
+    EEPROM_retStatus_t blankStatus = EEPROM_SUCCESS;
+    uint32_t readErrors = EEPROM_readErrors;
+
+    blankStatus = EEPROM_IsPageErased(EEPROM_backend->pageAddress[page]);
+    /* A failed read tells nothing about the page content: neither erase it nor take it as blank */
+    if (EEPROM_readErrors != readErrors) {
+        return EEPROM_ERROR;
+    }
+    if (blankStatus == EEPROM_SUCCESS) {
+        return EEPROM_SUCCESS;
+    }
+    return EEPROM_FlashErase(page);
+}
+
 static EEPROM_retStatus_t EEPROM_Format(void) {
-    HAL_StatusTypeDef flashStatus = HAL_OK;
-    uint32_t eraseError = 0;
-    FLASH_EraseInitTypeDef pEraseInit;
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
 
-    FLASH_ERASE_INIT(EEPROM_PAGE0_ID);
+#ifdef EEPROM_LOW_RAM
+    /* No variable survives a format */
+    memset(EEPROM_writtenMap, 0, sizeof(EEPROM_writtenMap));
+#endif
 
     /* Erase Page0 */
-    if (EEPROM_IsPageErased(EEPROM_PAGE0_ADDRESS) != EEPROM_SUCCESS) {
-        HAL_FLASH_Unlock();
-        flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-        HAL_FLASH_Lock();
-        /* If erase operation was failed, a Flash error code is returned */
-        if (flashStatus != HAL_OK) {
-            return EEPROM_ERROR;
-        }
+    flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE0);
+    /* If erase operation was failed, a Flash error code is returned */
+    if (flashStatus != EEPROM_SUCCESS) {
+        return EEPROM_ERROR;
     }
     /* Set Page0 as valid page: Write EEPROM_PAGE_ACTIVE at Page0 base address */
-    HAL_FLASH_Unlock();
-    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EEPROM_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
-    HAL_FLASH_Lock();
+    flashStatus = EEPROM_FlashProgram(BACKEND_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
     /* If program operation was failed, a Flash error code is returned */
-    if (flashStatus != HAL_OK) {
+    if (flashStatus != EEPROM_SUCCESS) {
         return EEPROM_ERROR;
     }
 
-    FLASH_ERASE_INIT(EEPROM_PAGE1_ID);
     /* Erase Page1 */
-    if (EEPROM_IsPageErased(EEPROM_PAGE1_ADDRESS) != EEPROM_SUCCESS) {
-        HAL_FLASH_Unlock();
-        flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-        HAL_FLASH_Lock();
-        /* If erase operation was failed, a Flash error code is returned */
-        if (flashStatus != HAL_OK) {
-            return EEPROM_ERROR;
-        }
+    flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE1);
+    /* If erase operation was failed, a Flash error code is returned */
+    if (flashStatus != EEPROM_SUCCESS) {
+        return EEPROM_ERROR;
     }
 
     return EEPROM_SUCCESS;
@@ -172,10 +403,22 @@ static EEPROM_retStatus_t EEPROM_Format(void) {
 
 static uint32_t EEPROM_FindValidPage(uint8_t Operation) {
     uint16_t pageStatus0 = 6, pageStatus1 = 6;
+    uint32_t validPage = EEPROM_PAGE0, readErrors = 0;
+
+    /* No backend selected */
+    if (EEPROM_backend == NULL) {
+        return EEPROM_NO_VALID_PAGE;
+    }
 
     /* Get page0 and page1 actual status */
-    pageStatus0 = FLASH_READ(EEPROM_PAGE0_ADDRESS);
-    pageStatus1 = FLASH_READ(EEPROM_PAGE1_ADDRESS);
+    readErrors = EEPROM_readErrors;
+    pageStatus0 = EEPROM_Read16(BACKEND_PAGE0_ADDRESS);
+    pageStatus1 = EEPROM_Read16(BACKEND_PAGE1_ADDRESS);
+
+    /* A header that could not be read would be decoded as a random status */
+    if (EEPROM_readErrors != readErrors) {
+        return EEPROM_NO_VALID_PAGE;
+    }
 
     /* Write or read operation */
     switch (Operation) {
@@ -183,41 +426,134 @@ static uint32_t EEPROM_FindValidPage(uint8_t Operation) {
             if (pageStatus1 == EEPROM_PAGE_ACTIVE) {
                 /* Page0 receiving data */
                 if (pageStatus0 == EEPROM_PAGE_RECEIVING) {
-                    return EEPROM_PAGE0_ID; /* Page0 valid */
+                    validPage = EEPROM_PAGE0; /* Page0 valid */
                 } else {
-                    return EEPROM_PAGE1_ID; /* Page1 valid */
+                    validPage = EEPROM_PAGE1; /* Page1 valid */
                 }
             } else if (pageStatus0 == EEPROM_PAGE_ACTIVE) {
                 /* Page1 receiving data */
                 if (pageStatus1 == EEPROM_PAGE_RECEIVING) {
-                    return EEPROM_PAGE1_ID; /* Page1 valid */
+                    validPage = EEPROM_PAGE1; /* Page1 valid */
                 } else {
-                    return EEPROM_PAGE0_ID; /* Page0 valid */
+                    validPage = EEPROM_PAGE0; /* Page0 valid */
                 }
             } else {
-                return EEPROM_NO_VALID_PAGE; /* No valid Page */
+                validPage = EEPROM_NO_VALID_PAGE; /* No valid Page */
             }
+            break;
 
         case OP_READ_VALID_PAGE: /* ---- Read operation ---- */
             if (pageStatus0 == EEPROM_PAGE_ACTIVE) {
-                return EEPROM_PAGE0_ID; /* Page0 valid */
+                validPage = EEPROM_PAGE0; /* Page0 valid */
             } else if (pageStatus1 == EEPROM_PAGE_ACTIVE) {
-                return EEPROM_PAGE1_ID; /* Page1 valid */
+                validPage = EEPROM_PAGE1; /* Page1 valid */
             } else {
-                return EEPROM_NO_VALID_PAGE; /* No valid Page */
+                validPage = EEPROM_NO_VALID_PAGE; /* No valid Page */
             }
+            break;
 
-        default: return EEPROM_PAGE0_ID; /* Page0 valid */
+        default: validPage = EEPROM_PAGE0; /* Page0 valid */
     }
+
+    return validPage;
+}
+
+static EEPROM_retStatus_t EEPROM_FindRecordInPage(uint32_t startAddress, uint16_t virtAddress, uint32_t* recordAddress) {
+    uint16_t addressValue = 0x5555;
+    uint32_t address = 0;
+#ifdef EEPROM_LAYOUT_SLOTS
+    uint32_t endAddress = 0;
+    EEPROM_retStatus_t retStatus = EEPROM_ERROR;
+#endif
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_START, startAddress);
+#ifdef EEPROM_LAYOUT_SLOTS
+    /* Only the region of the variable is searched, up to its first blank record */
+    address = EEPROM_SLOT_ADDRESS(startAddress, virtAddress);
+    endAddress = address + EEPROM_SLOT_SIZE;
+    while ((address < endAddress) && (EEPROM_Read32(address) != EEPROM_RECORD_BLANK)) {
+        /* Skip torn records, keep the last complete one */
+        addressValue = EEPROM_Read16(address + EEPROM_RECORD_ADDRESS_OFFSET);
+        if (addressValue == virtAddress) {
+            *recordAddress = address;
+            retStatus = EEPROM_SUCCESS;
+        }
+        address += EEPROM_RECORD_SIZE;
+    }
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+    return retStatus;
+#else
+#ifdef EEPROM_LOW_RAM
+    /* Start from the virtual address of the last written record */
+    address = EEPROM_FindTail(startAddress) - EEPROM_RECORD_SIZE + EEPROM_RECORD_ADDRESS_OFFSET;
+#else
+    /* Get the valid Page end Address */
+    address = (uint32_t)(startAddress + (BACKEND_PAGE_SIZE - EEPROM_RECORD_SIZE + EEPROM_RECORD_ADDRESS_OFFSET));
+#endif
+
+    /* Check each active page address starting from end */
+    while (address > (startAddress + EEPROM_RECORD_ADDRESS_OFFSET)) {
+        /* Get the current location content to be compared with virtual address */
+        addressValue = EEPROM_Read16(address);
+
+        /* Compare the read address with the virtual address */
+        if (addressValue == virtAddress) {
+            /* Record starts at address-2 */
+            *recordAddress = address - EEPROM_RECORD_ADDRESS_OFFSET;
+            EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, *recordAddress);
+            return EEPROM_SUCCESS;
+        } else {
+            /* Next address location */
+            address -= EEPROM_RECORD_SIZE;
+        }
+    }
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+    return EEPROM_ERROR;
+#endif
+}
+
+static EEPROM_retStatus_t EEPROM_FindRecord(uint16_t virtAddress, uint32_t* recordAddress) {
+    uint32_t validPage = EEPROM_PAGE0;
+#ifdef EEPROM_LAZY_INIT
+    uint32_t pageAddress[2] = {BACKEND_PAGE0_ADDRESS, BACKEND_PAGE1_ADDRESS};
+    EEPROM_retStatus_t retStatus = EEPROM_SUCCESS;
+    uint16_t ii = 0;
+
+    /* Until the deferred recovery runs, the receiving page of an interrupted transfer holds the newest records */
+    if (EEPROM_recoveryPending) {
+        for (ii = 0; ii < 2; ii++) {
+            if (EEPROM_Read16(pageAddress[ii]) == EEPROM_PAGE_RECEIVING) {
+                retStatus = EEPROM_FindRecordInPage(pageAddress[ii], virtAddress, recordAddress);
+                /* Fall back to the active page, if any, for variables not transferred yet */
+                if ((retStatus == EEPROM_SUCCESS) || (EEPROM_Read16(pageAddress[ii ^ 1U]) != EEPROM_PAGE_ACTIVE)) {
+                    return retStatus;
+                }
+            }
+        }
+    }
+#endif
+
+    /* Get active Page for read operation */
+    validPage = EEPROM_FindValidPage(OP_READ_VALID_PAGE);
+
+    /* Search the valid Page */
+    if (validPage == EEPROM_PAGE0) {
+        return EEPROM_FindRecordInPage(BACKEND_PAGE0_ADDRESS, virtAddress, recordAddress);
+    } else if (validPage == EEPROM_PAGE1) {
+        return EEPROM_FindRecordInPage(BACKEND_PAGE1_ADDRESS, virtAddress, recordAddress);
+    }
+    return EEPROM_NO_VALID_PAGE;
 }
 
 static EEPROM_retStatus_t EEPROM_VerifyPageAndWrite(uint16_t virtAddress, uint16_t data) {
-    HAL_StatusTypeDef flashStatus = HAL_OK;
-    uint32_t validPage = EEPROM_PAGE0_ID;
-    uint32_t address = EEPROM_PAGE0_ADDRESS, endAddress = EEPROM_PAGE0_ADDRESS + EEPROM_PAGE_SIZE;
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
+    uint32_t validPage = EEPROM_PAGE0;
+    uint32_t address = 0, endAddress = 0, readErrors = EEPROM_readErrors;
 
     /* Get valid Page for write operation */
     validPage = EEPROM_FindValidPage(OP_WRITE_VALID_PAGE);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_FIND_PAGE, validPage);
 
     /* Check if there is no valid page */
     if (validPage == EEPROM_NO_VALID_PAGE) {
@@ -225,85 +561,101 @@ static EEPROM_retStatus_t EEPROM_VerifyPageAndWrite(uint16_t virtAddress, uint16
     }
 
     /* Get the valid Page start Address */
-    if (validPage == EEPROM_PAGE0_ID) {
-        address = EEPROM_PAGE0_ADDRESS;
-    } else if (validPage == EEPROM_PAGE1_ID) {
-        address = EEPROM_PAGE1_ADDRESS;
+    if (validPage == EEPROM_PAGE0) {
+        address = BACKEND_PAGE0_ADDRESS;
+    } else if (validPage == EEPROM_PAGE1) {
+        address = BACKEND_PAGE1_ADDRESS;
     } else {
         return EEPROM_NO_VALID_PAGE;
     }
 
+#ifdef EEPROM_LAYOUT_SLOTS
+    /* Only the region of the variable is searched, a full region triggers the page transfer */
+    address = EEPROM_SLOT_ADDRESS(address, virtAddress);
+    endAddress = address + EEPROM_SLOT_SIZE - EEPROM_RECORD_SIZE;
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_START, address);
+#else
     /* Get the valid Page end Address */
-    endAddress = (uint32_t)(address + (EEPROM_PAGE_SIZE - 4U));
+    endAddress = (uint32_t)(address + (BACKEND_PAGE_SIZE - EEPROM_RECORD_SIZE));
+
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_START, address);
+#ifdef EEPROM_LOW_RAM
+    /* Jump straight to the first blank record */
+    address = EEPROM_FindTail(address);
+#endif
+#endif
 
     /* Check each active page address starting from beginning */
     while (address <= endAddress) {
         /* Verify if Address and Address+2 contents are 0xFFFFFFFF */
-        if (FLASH_READ32(address) == 0xFFFFFFFF) {
+        if (EEPROM_Read32(address) == EEPROM_RECORD_BLANK) {
+            EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+            /* Never program a record found through a failed read */
+            if (EEPROM_readErrors != readErrors) {
+                return EEPROM_ERROR;
+            }
             /* Set variable data */
-            HAL_FLASH_Unlock();
-            flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address, data);
-            HAL_FLASH_Lock();
+            flashStatus = EEPROM_FlashProgram(address + EEPROM_RECORD_VALUE_OFFSET, data);
             /* If program operation was failed, a Flash error code is returned */
-            if (flashStatus != HAL_OK) {
+            if (flashStatus != EEPROM_SUCCESS) {
                 return EEPROM_ERROR;
             }
             /* Set variable virtual address */
-            HAL_FLASH_Unlock();
-            flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + 2, virtAddress);
-            HAL_FLASH_Lock();
+            flashStatus = EEPROM_FlashProgram(address + EEPROM_RECORD_ADDRESS_OFFSET, virtAddress);
             /* Return program operation status */
-            if (flashStatus != HAL_OK) {
+            if (flashStatus != EEPROM_SUCCESS) {
                 return EEPROM_ERROR;
             }
+#ifdef EEPROM_LOW_RAM
+            EEPROM_MAP_SET(virtAddress);
+#endif
             return EEPROM_SUCCESS;
         } else {
             /* Next address location */
-            address += 4;
+            address += EEPROM_RECORD_SIZE;
         }
     }
 
-    /* Return PAGE_FULL in case the valid page is full */
-    return EEPROM_PAGE_FULL;
+    /* Return PAGE_FULL in case the valid page is full, unless a failed read hid a blank record */
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_SCAN_END, address);
+    return (EEPROM_readErrors != readErrors) ? EEPROM_ERROR : EEPROM_PAGE_FULL;
 }
 
 static EEPROM_retStatus_t EEPROM_PageTransfer(uint16_t virtAddress, uint16_t data) {
-    HAL_StatusTypeDef flashStatus = HAL_OK;
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
     EEPROM_retStatus_t eepromStatus = EEPROM_SUCCESS, readStatus = EEPROM_SUCCESS;
-    FLASH_EraseInitTypeDef pEraseInit;
-    uint32_t eraseError = 0;
     uint16_t tmpData = 0, ii = 0;
-    uint32_t newPageAddress = EEPROM_PAGE0_ADDRESS;
+    uint32_t newPageAddress = 0, readErrors = EEPROM_readErrors;
     uint32_t oldPageId = 0;
-    uint32_t validPage = EEPROM_PAGE0_ID;
+    uint32_t validPage = EEPROM_PAGE0;
 
     /* Get active Page for read operation */
     validPage = EEPROM_FindValidPage(OP_READ_VALID_PAGE);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_FIND_PAGE, validPage);
 
-    if (validPage == EEPROM_PAGE1_ID) /* Page1 valid */
+    if (validPage == EEPROM_PAGE1) /* Page1 valid */
     {
         /* New page address where variable will be moved to */
-        newPageAddress = EEPROM_PAGE0_ADDRESS;
+        newPageAddress = BACKEND_PAGE0_ADDRESS;
 
         /* Old page ID where variable will be taken from */
-        oldPageId = EEPROM_PAGE1_ID;
-    } else if (validPage == EEPROM_PAGE0_ID) /* Page0 valid */
+        oldPageId = EEPROM_PAGE1;
+    } else if (validPage == EEPROM_PAGE0) /* Page0 valid */
     {
         /* New page address  where variable will be moved to */
-        newPageAddress = EEPROM_PAGE1_ADDRESS;
+        newPageAddress = BACKEND_PAGE1_ADDRESS;
 
         /* Old page ID where variable will be taken from */
-        oldPageId = EEPROM_PAGE0_ID;
+        oldPageId = EEPROM_PAGE0;
     } else {
         return EEPROM_NO_VALID_PAGE; /* No valid Page */
     }
 
     /* Set the new Page status to EEPROM_PAGE_RECEIVING status */
-    HAL_FLASH_Unlock();
-    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, newPageAddress, EEPROM_PAGE_RECEIVING);
-    HAL_FLASH_Lock();
+    flashStatus = EEPROM_FlashProgram(newPageAddress, EEPROM_PAGE_RECEIVING);
     /* If program operation was failed, a Flash error code is returned */
-    if (flashStatus != HAL_OK) {
+    if (flashStatus != EEPROM_SUCCESS) {
         return EEPROM_ERROR;
     }
 
@@ -320,6 +672,10 @@ static EEPROM_retStatus_t EEPROM_PageTransfer(uint16_t virtAddress, uint16_t dat
         {
             /* Read the other last variable updates */
             readStatus = EEPROM_ReadVariable(ii, &tmpData);
+            /* A variable that could not be read would be lost with the old page */
+            if (EEPROM_readErrors != readErrors) {
+                return EEPROM_ERROR;
+            }
             /* In case variable corresponding to the virtual address was found */
             if (readStatus == EEPROM_SUCCESS) {
                 /* Transfer the variable to the new active page */
@@ -332,23 +688,17 @@ static EEPROM_retStatus_t EEPROM_PageTransfer(uint16_t virtAddress, uint16_t dat
         }
     }
 
-    FLASH_ERASE_INIT(oldPageId);
-
     /* Erase the old Page: Set old Page status to ERASED status */
-    HAL_FLASH_Unlock();
-    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-    HAL_FLASH_Lock();
+    flashStatus = EEPROM_FlashErase(oldPageId);
     /* If erase operation was failed, a Flash error code is returned */
-    if (flashStatus != HAL_OK) {
+    if (flashStatus != EEPROM_SUCCESS) {
         return EEPROM_ERROR;
     }
 
     /* Set new Page status to EEPROM_PAGE_ACTIVE status */
-    HAL_FLASH_Unlock();
-    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, newPageAddress, EEPROM_PAGE_ACTIVE);
-    HAL_FLASH_Unlock();
+    flashStatus = EEPROM_FlashProgram(newPageAddress, EEPROM_PAGE_ACTIVE);
     /* If program operation was failed, a Flash error code is returned */
-    if (flashStatus != HAL_OK) {
+    if (flashStatus != EEPROM_SUCCESS) {
         return EEPROM_ERROR;
     }
 
@@ -356,51 +706,24 @@ static EEPROM_retStatus_t EEPROM_PageTransfer(uint16_t virtAddress, uint16_t dat
     return EEPROM_SUCCESS;
 }
 
-/* Functions -----------------------------------------------------------------*/
-
-EEPROM_retStatus_t EEPROM_Init(void) {
-    uint16_t pageStatus0, pageStatus1;
-    HAL_StatusTypeDef flashStatus = HAL_OK;
+static EEPROM_retStatus_t EEPROM_Recover(uint16_t pageStatus0, uint16_t pageStatus1) {
+    EEPROM_retStatus_t flashStatus = EEPROM_SUCCESS;
     EEPROM_retStatus_t eepromStatus = EEPROM_SUCCESS, readStatus = EEPROM_SUCCESS;
-    FLASH_EraseInitTypeDef pEraseInit;
-    uint32_t eraseError = 0;
     uint16_t tmpData = 0, ii = 0;
-    int16_t x = -1;
-
-#ifdef HAL_ICACHE_MODULE_ENABLED
-    /* disabling ICACHE if enabled*/
-    HAL_ICACHE_Disable();
-#endif
-
-    /* Get pages status */
-    pageStatus0 = FLASH_READ(EEPROM_PAGE0_ADDRESS);
-    pageStatus1 = FLASH_READ(EEPROM_PAGE1_ADDRESS);
-
-    /* Set erase configuration */
-    FLASH_ERASE_INIT(EEPROM_PAGE0_ID);
+    uint32_t readErrors = EEPROM_readErrors;
 
     /* Check for invalid header states and repair if necessary */
     switch (pageStatus0) {
         case EEPROM_PAGE_CLEARED:
             if (pageStatus1 == EEPROM_PAGE_ACTIVE) { /* Page0 erased, Page1 valid */
                 /* Erase Page0 */
-                if (EEPROM_IsPageErased(EEPROM_PAGE0_ADDRESS) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
-                }
+                flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE0);
             } else if (pageStatus1 == EEPROM_PAGE_RECEIVING) { /* Page0 erased, Page1 receive */
                 /* Erase Page0 */
-                if (EEPROM_IsPageErased(EEPROM_PAGE0_ADDRESS) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
-                }
+                flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE0);
                 /* Mark Page1 as valid */
-                if (flashStatus == HAL_OK) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EEPROM_PAGE1_ADDRESS, EEPROM_PAGE_ACTIVE);
-                    HAL_FLASH_Lock();
+                if (flashStatus == EEPROM_SUCCESS) {
+                    flashStatus = EEPROM_FlashProgram(BACKEND_PAGE1_ADDRESS, EEPROM_PAGE_ACTIVE);
                 }
             } else { /* First EEPROM access (Page0&1 are erased) or invalid state -> format EEPROM */
                 /* Erase both Page0 and Page1 and set Page0 as valid page */
@@ -412,10 +735,9 @@ EEPROM_retStatus_t EEPROM_Init(void) {
             if (pageStatus1 == EEPROM_PAGE_ACTIVE) { /* Page0 receive, Page1 valid */
                 /* Transfer data from Page1 to Page0 */
                 for (ii = 0; ii < EEPROM_VAR_NUM; ii++) {
-                    if (FLASH_READ(EEPROM_PAGE0_ADDRESS + 6) == ii) {
-                        x = ii;
-                    }
-                    if (ii != x) {
+                    /* Skip variables already transferred: the one that triggered the transfer, and those copied by an
+                       earlier recovery attempt that failed */
+                    if (!EEPROM_IsTransferred(BACKEND_PAGE0_ADDRESS, ii)) {
                         /* Read the last variables' updates */
                         readStatus = EEPROM_ReadVariable(ii, &tmpData);
                         /* In case variable corresponding to the virtual address was found */
@@ -424,38 +746,27 @@ EEPROM_retStatus_t EEPROM_Init(void) {
                             eepromStatus = EEPROM_VerifyPageAndWrite(ii, tmpData);
                             /* If program operation was failed, an error is returned */
                             if (eepromStatus != EEPROM_SUCCESS) {
-#ifdef HAL_ICACHE_MODULE_ENABLED
-                                HAL_ICACHE_Enable();
-#endif
                                 return eepromStatus;
                             }
                         }
                     }
                 }
+                /* Keep both pages if any variable could not be read, the transfer is resumed at the next attempt */
+                if (EEPROM_readErrors != readErrors) {
+                    return EEPROM_ERROR;
+                }
                 /* Mark Page0 as valid */
-                HAL_FLASH_Unlock();
-                flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EEPROM_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
-                HAL_FLASH_Lock();
-                FLASH_ERASE_INIT(EEPROM_PAGE1_ID);
-                /* Erase Page1 */
-                if ((flashStatus == HAL_OK) && (EEPROM_IsPageErased(EEPROM_PAGE1_ADDRESS)) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
+                flashStatus = EEPROM_FlashProgram(BACKEND_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
+                /* Erase Page1: it was active, so it is never blank and needs no check */
+                if (flashStatus == EEPROM_SUCCESS) {
+                    flashStatus = EEPROM_FlashErase(EEPROM_PAGE1);
                 }
             } else if (pageStatus1 == EEPROM_PAGE_CLEARED) { /* Page0 receive, Page1 erased */
-                FLASH_ERASE_INIT(EEPROM_PAGE1_ID);
                 /* Erase Page1 */
-                if (EEPROM_IsPageErased(EEPROM_PAGE1_ADDRESS) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
-                }
+                flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE1);
                 /* Mark Page0 as valid */
-                if (flashStatus == HAL_OK) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EEPROM_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
-                    HAL_FLASH_Lock();
+                if (flashStatus == EEPROM_SUCCESS) {
+                    flashStatus = EEPROM_FlashProgram(BACKEND_PAGE0_ADDRESS, EEPROM_PAGE_ACTIVE);
                 }
             } else { /* Invalid state -> format eeprom */
                 /* Erase both Page0 and Page1 and set Page0 as valid page */
@@ -468,20 +779,14 @@ EEPROM_retStatus_t EEPROM_Init(void) {
                 /* Erase both Page0 and Page1 and set Page0 as valid page */
                 eepromStatus = EEPROM_Format();
             } else if (pageStatus1 == EEPROM_PAGE_CLEARED) { /* Page0 valid, Page1 erased */
-                FLASH_ERASE_INIT(EEPROM_PAGE1_ID);
                 /* Erase Page1 */
-                if (EEPROM_IsPageErased(EEPROM_PAGE1_ADDRESS) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
-                }
+                flashStatus = EEPROM_ErasePageIfNeeded(EEPROM_PAGE1);
             } else { /* Page0 valid, Page1 receive */
                 /* Transfer data from Page0 to Page1 */
                 for (ii = 0; ii < EEPROM_VAR_NUM; ii++) {
-                    if (FLASH_READ(EEPROM_PAGE1_ADDRESS + 6) == ii) {
-                        x = ii;
-                    }
-                    if (ii != x) {
+                    /* Skip variables already transferred: the one that triggered the transfer, and those copied by an
+                       earlier recovery attempt that failed */
+                    if (!EEPROM_IsTransferred(BACKEND_PAGE1_ADDRESS, ii)) {
                         /* Read the last variables' updates */
                         readStatus = EEPROM_ReadVariable(ii, &tmpData);
                         /* In case variable corresponding to the virtual address was found */
@@ -490,25 +795,21 @@ EEPROM_retStatus_t EEPROM_Init(void) {
                             eepromStatus = EEPROM_VerifyPageAndWrite(ii, tmpData);
                             /* If program operation was failed, an error is returned */
                             if (eepromStatus != EEPROM_SUCCESS) {
-#ifdef HAL_ICACHE_MODULE_ENABLED
-                                HAL_ICACHE_Enable();
-#endif
                                 return eepromStatus;
                             }
                         }
                     }
                 }
+                /* Keep both pages if any variable could not be read, the transfer is resumed at the next attempt */
+                if (EEPROM_readErrors != readErrors) {
+                    return EEPROM_ERROR;
+                }
                 eepromStatus = EEPROM_SUCCESS;
                 /* Mark Page1 as valid */
-                HAL_FLASH_Unlock();
-                flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EEPROM_PAGE1_ADDRESS, EEPROM_PAGE_ACTIVE);
-                HAL_FLASH_Lock();
-                FLASH_ERASE_INIT(EEPROM_PAGE0_ID);
-                /* Erase Page0 */
-                if ((flashStatus == HAL_OK) && (EEPROM_IsPageErased(EEPROM_PAGE0_ADDRESS)) != EEPROM_SUCCESS) {
-                    HAL_FLASH_Unlock();
-                    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
-                    HAL_FLASH_Lock();
+                flashStatus = EEPROM_FlashProgram(BACKEND_PAGE1_ADDRESS, EEPROM_PAGE_ACTIVE);
+                /* Erase Page0: it was active, so it is never blank and needs no check */
+                if (flashStatus == EEPROM_SUCCESS) {
+                    flashStatus = EEPROM_FlashErase(EEPROM_PAGE0);
                 }
             }
             break;
@@ -519,79 +820,299 @@ EEPROM_retStatus_t EEPROM_Init(void) {
             break;
     }
 
+    return (((flashStatus != EEPROM_SUCCESS) || (eepromStatus != EEPROM_SUCCESS)) ? EEPROM_ERROR : EEPROM_SUCCESS);
+}
+
+#ifdef EEPROM_LAZY_INIT
+static EEPROM_retStatus_t EEPROM_FinishRecovery(void) {
+    EEPROM_retStatus_t eepromStatus = EEPROM_SUCCESS;
+    uint16_t pageStatus0, pageStatus1;
+    uint32_t readErrors;
+
+    if (!EEPROM_recoveryPending) {
+        return EEPROM_SUCCESS;
+    }
+
+#ifdef HAL_ICACHE_MODULE_ENABLED
+    /* disabling ICACHE if enabled*/
+    HAL_ICACHE_Disable();
+#endif
+
+    readErrors = EEPROM_readErrors;
+    pageStatus0 = EEPROM_Read16(BACKEND_PAGE0_ADDRESS);
+    pageStatus1 = EEPROM_Read16(BACKEND_PAGE1_ADDRESS);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_RECOVERY_START, ((uint32_t)pageStatus1 << 16) | pageStatus0);
+
+    /* Reads keep looking at the receiving page until the recovery is complete */
+    if (EEPROM_readErrors != readErrors) {
+        eepromStatus = EEPROM_ERROR;
+    } else {
+        eepromStatus = EEPROM_Recover(pageStatus0, pageStatus1);
+    }
+    if (eepromStatus == EEPROM_SUCCESS) {
+        EEPROM_recoveryPending = 0;
+    }
+
 #ifdef HAL_ICACHE_MODULE_ENABLED
     HAL_ICACHE_Enable();
 #endif
-    return (((flashStatus != HAL_OK) || (eepromStatus != EEPROM_SUCCESS)) ? EEPROM_ERROR : EEPROM_SUCCESS);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_RECOVERY_END, eepromStatus);
+    return eepromStatus;
 }
+#endif
 
-EEPROM_retStatus_t EEPROM_ReadVariable(uint16_t virtAddress, uint16_t* value) {
-    uint32_t validPage = EEPROM_PAGE0_ID;
-    uint16_t addressValue = 0x5555;
-    uint32_t address = EEPROM_PAGE0_ADDRESS, startAddress = EEPROM_PAGE0_ADDRESS;
+#ifdef EEPROM_ISR_QUEUE_SIZE
+static uint32_t EEPROM_QueuePeek(void) {
+#ifdef EEPROM_ISR_QUEUE_OVERWRITE
+    uint32_t head = 0, tail = 0, count = 0, ii = 0;
 
-    if (virtAddress >= EEPROM_VAR_NUM) {
+    while (1) {
+        head = EEPROM_queueHead;
+
+        /* Skip entries already overwritten, keeping one slot of margin for the one being written */
+        if ((head - EEPROM_queueTail) >= EEPROM_ISR_QUEUE_SIZE) {
+            EEPROM_queueOverflow += head - EEPROM_queueTail - (EEPROM_ISR_QUEUE_SIZE - 1U);
+            EEPROM_queueTail = head - (EEPROM_ISR_QUEUE_SIZE - 1U);
+        }
+        tail = EEPROM_queueTail;
+
+        /* Copy the queued entries without releasing their slots */
+        count = head - tail;
+        for (ii = 0; ii < count; ii++) {
+            EEPROM_queueBatch[ii] = EEPROM_queueBuffer[(tail + ii) & (EEPROM_ISR_QUEUE_SIZE - 1U)];
+        }
+
+        /* Start over if the producer overwrote the oldest entry while it was being copied */
+        if ((EEPROM_queueHead - tail) < EEPROM_ISR_QUEUE_SIZE) {
+            return count;
+        }
+    }
+#else
+    /* Entries stay in place until the tail is advanced past them */
+    return EEPROM_queueHead - EEPROM_queueTail;
+#endif
+}
+
+static EEPROM_retStatus_t EEPROM_DrainQueue(void) {
+    EEPROM_retStatus_t writeStatus = EEPROM_SUCCESS;
+    uint32_t tail = 0, count = 0, ii = 0, entry = 0;
+
+    /* Take at most one queue worth of entries, so that a burst of interrupts cannot keep the caller busy */
+    count = EEPROM_QueuePeek();
+    tail = EEPROM_queueTail;
+    if (count == 0) {
+        return EEPROM_SUCCESS;
+    }
+
+    /* Coalesce duplicate addresses in a single backward pass: only the last queued value of each address is written */
+    memset(EEPROM_queueSeen, 0, sizeof(EEPROM_queueSeen));
+    memset(EEPROM_queueLast, 0, sizeof(EEPROM_queueLast));
+    for (ii = count; ii > 0; ii--) {
+        entry = EEPROM_QUEUE_BATCH(tail, ii - 1U);
+        if (!EEPROM_QUEUE_SEEN_GET(EEPROM_QUEUE_ADDRESS(entry))) {
+            EEPROM_QUEUE_SEEN_SET(EEPROM_QUEUE_ADDRESS(entry));
+            EEPROM_QUEUE_LAST_SET(ii - 1U);
+        }
+    }
+
+    for (ii = 0; ii < count; ii++) {
+        if (EEPROM_QUEUE_LAST_GET(ii)) {
+            entry = EEPROM_QUEUE_BATCH(tail, ii);
+            writeStatus = EEPROM_WriteVariable(EEPROM_QUEUE_ADDRESS(entry), EEPROM_QUEUE_VALUE(entry));
+            /* Keep the failed entry and the following ones queued, they are retried by the next call */
+            if (writeStatus != EEPROM_SUCCESS) {
+                return writeStatus;
+            }
+        }
+        /* Release the slot only once its value is in flash, or superseded by a later entry still queued */
+        EEPROM_queueTail = tail + ii + 1U;
+    }
+    return EEPROM_SUCCESS;
+}
+#endif
+
+/* Functions -----------------------------------------------------------------*/
+
+EEPROM_retStatus_t EEPROM_SetBackend(const EEPROM_backend_t* backend) {
+    if ((backend == NULL) || (backend->program == NULL) || (backend->erase == NULL) || (!backend->isMapped && (backend->read == NULL))) {
         return EEPROM_ERROR;
     }
+    /* Pages must hold the header and at least one record */
+    if ((backend->pageSize < (2U * EEPROM_RECORD_SIZE)) || ((backend->pageSize % EEPROM_RECORD_SIZE) != 0)) {
+        return EEPROM_ERROR;
+    }
+
+    EEPROM_backend = backend;
+    EEPROM_isMapped = backend->isMapped;
+    EEPROM_mapOffset = backend->mapOffset;
+    EEPROM_blankInvert = (uint32_t)(0xFFU ^ backend->blankValue) * 0x01010101U;
+    return EEPROM_SUCCESS;
+}
+
+EEPROM_retStatus_t EEPROM_Init(void) {
+    uint16_t pageStatus0, pageStatus1;
+    uint32_t readErrors;
+    EEPROM_retStatus_t eepromStatus = EEPROM_SUCCESS;
+
+    if (EEPROM_backend == NULL) {
+        return EEPROM_ERROR;
+    }
+
+#ifdef EEPROM_LAYOUT_SLOTS
+    /* Each variable needs a region of at least one record */
+    if (EEPROM_SLOT_RECORDS(BACKEND_PAGE_SIZE, EEPROM_VAR_NUM) == 0) {
+        return EEPROM_ERROR;
+    }
+#endif
 
 #ifdef HAL_ICACHE_MODULE_ENABLED
     /* disabling ICACHE if enabled*/
     HAL_ICACHE_Disable();
 #endif
 
-    /* Get active Page for read operation */
-    validPage = EEPROM_FindValidPage(OP_READ_VALID_PAGE);
-
-    /* Check if there is no valid page */
-    if (validPage == EEPROM_NO_VALID_PAGE) {
-#ifdef HAL_ICACHE_MODULE_ENABLED
-        HAL_ICACHE_Enable();
+#ifdef EEPROM_TRACE_USE_DWT
+    /* Start the cycle counter used for trace timestamps */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 #endif
-        return EEPROM_NO_VALID_PAGE;
+
+    /* Get pages status */
+    readErrors = EEPROM_readErrors;
+    pageStatus0 = EEPROM_Read16(BACKEND_PAGE0_ADDRESS);
+    pageStatus1 = EEPROM_Read16(BACKEND_PAGE1_ADDRESS);
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_INIT_START, ((uint32_t)pageStatus1 << 16) | pageStatus0);
+
+#ifdef EEPROM_LOW_RAM
+    /* Rebuild the "ever written" map, it is needed by the reads performed during recovery */
+    EEPROM_BuildWrittenMap();
+    EEPROM_mapValid = (uint8_t)(EEPROM_readErrors == readErrors);
+    if (!EEPROM_mapValid) {
+        memset(EEPROM_writtenMap, 0, sizeof(EEPROM_writtenMap));
     }
+#endif
 
-    /* Get the valid Page start Address */
-    if (validPage == EEPROM_PAGE0_ID) {
-        startAddress = EEPROM_PAGE0_ADDRESS;
-    } else if (validPage == EEPROM_PAGE1_ID) {
-        startAddress = EEPROM_PAGE1_ADDRESS;
+    /* Unreadable pages must not be mistaken for an invalid state and formatted */
+    if (EEPROM_readErrors != readErrors) {
+        eepromStatus = EEPROM_ERROR;
     } else {
-#ifdef HAL_ICACHE_MODULE_ENABLED
-        HAL_ICACHE_Enable();
+#ifdef EEPROM_LAZY_INIT
+        /* Consistent states are repaired later by EEPROM_Process() or by the first write, invalid ones are formatted now */
+        EEPROM_recoveryPending = (uint8_t)((pageStatus0 != pageStatus1) && EEPROM_IS_PAGE_STATUS(pageStatus0) && EEPROM_IS_PAGE_STATUS(pageStatus1));
+        if (!EEPROM_recoveryPending) {
+            eepromStatus = EEPROM_Recover(pageStatus0, pageStatus1);
+        }
+#else
+        eepromStatus = EEPROM_Recover(pageStatus0, pageStatus1);
 #endif
-        return EEPROM_NO_VALID_PAGE;
     }
 
-    /* Get the valid Page end Address */
-    address = (uint32_t)(startAddress + (EEPROM_PAGE_SIZE - 2U));
+#ifdef HAL_ICACHE_MODULE_ENABLED
+    HAL_ICACHE_Enable();
+#endif
+    EEPROM_TRACE_EVENT(EEPROM_TRACE_INIT_END, eepromStatus);
+    return eepromStatus;
+}
 
-    /* Check each active page address starting from end */
-    while (address > (startAddress + 2)) {
-        /* Get the current location content to be compared with virtual address */
-        addressValue = FLASH_READ(address);
+EEPROM_retStatus_t EEPROM_ReadVariable(uint16_t virtAddress, uint16_t* value) {
+    EEPROM_retStatus_t retStatus = EEPROM_SUCCESS;
+    uint32_t recordAddress = 0, readErrors = EEPROM_readErrors;
+    uint16_t tmpData = 0;
 
-        /* Compare the read address with the virtual address */
-        if (addressValue == virtAddress) {
-            /* Get content of address-2 which is variable value */
-            *value = FLASH_READ(address - 2U);
+    if (virtAddress >= EEPROM_VAR_NUM) {
+        return EEPROM_ERROR;
+    }
+
+#ifdef EEPROM_LOW_RAM
+    /* Variable never written, no need to scan the page */
+    if (!EEPROM_MAP_GET(virtAddress)) {
+        return EEPROM_ERROR;
+    }
+#endif
 
 #ifdef HAL_ICACHE_MODULE_ENABLED
-            HAL_ICACHE_Enable();
+    /* disabling ICACHE if enabled*/
+    HAL_ICACHE_Disable();
 #endif
-            return EEPROM_SUCCESS;
 
-            break;
-        } else {
-            /* Next address location */
-            address -= 4;
-        }
+    /* Look for the last record of the variable */
+    retStatus = EEPROM_FindRecord(virtAddress, &recordAddress);
+    if (retStatus == EEPROM_SUCCESS) {
+        tmpData = EEPROM_Read16(recordAddress + EEPROM_RECORD_VALUE_OFFSET);
     }
 
 #ifdef HAL_ICACHE_MODULE_ENABLED
     HAL_ICACHE_Enable();
 #endif
 
-    return EEPROM_ERROR;
+    /* Any failed read may have led to the wrong record */
+    if (EEPROM_readErrors != readErrors) {
+        return EEPROM_ERROR;
+    }
+    if (retStatus == EEPROM_SUCCESS) {
+        *value = tmpData;
+    }
+    return retStatus;
+}
+
+const void* EEPROM_GetConstPtr(uint16_t virtAddress, uint16_t* len) {
+#ifdef HAL_ICACHE_MODULE_ENABLED
+    /* Flash must be read with ICACHE disabled, so a pointer used once ICACHE is back on is not reliable */
+    (void)virtAddress;
+    (void)len;
+    return NULL;
+#else
+    EEPROM_retStatus_t retStatus = EEPROM_SUCCESS;
+    uint32_t recordAddress = 0;
+
+    if (virtAddress >= EEPROM_VAR_NUM) {
+        return NULL;
+    }
+
+#ifdef EEPROM_LOW_RAM
+    /* Variable never written, no need to scan the page */
+    if (!EEPROM_MAP_GET(virtAddress)) {
+        return NULL;
+    }
+#endif
+
+    /* Look for the last record of the variable */
+    retStatus = EEPROM_FindRecord(virtAddress, &recordAddress);
+
+    /* Only possible if the backend is memory-mapped and stores data as is */
+    if ((retStatus != EEPROM_SUCCESS) || !EEPROM_isMapped || (EEPROM_blankInvert != 0)) {
+        return NULL;
+    }
+    if (len != NULL) {
+        *len = (uint16_t)sizeof(uint16_t);
+    }
+    return (const void*)(EEPROM_mapOffset + recordAddress + EEPROM_RECORD_VALUE_OFFSET);
+#endif
+}
+
+uint32_t EEPROM_GetGeneration(void) { return EEPROM_generation; }
+
+EEPROM_retStatus_t EEPROM_Process(void) {
+    EEPROM_retStatus_t retStatus = EEPROM_SUCCESS;
+
+#ifdef EEPROM_LOW_RAM
+    /* The deferred recovery copies variables through the map too */
+    if (!EEPROM_mapValid) {
+        return EEPROM_ERROR;
+    }
+#endif
+
+#ifdef EEPROM_LAZY_INIT
+    retStatus = EEPROM_FinishRecovery();
+    if (retStatus != EEPROM_SUCCESS) {
+        return retStatus;
+    }
+#endif
+
+#ifdef EEPROM_ISR_QUEUE_SIZE
+    retStatus = EEPROM_DrainQueue();
+#endif
+
+    return retStatus;
 }
 
 EEPROM_retStatus_t EEPROM_WriteVariable(uint16_t virtAddress, uint16_t value) {
@@ -601,6 +1122,21 @@ EEPROM_retStatus_t EEPROM_WriteVariable(uint16_t virtAddress, uint16_t value) {
         return EEPROM_ERROR;
     }
 
+#ifdef EEPROM_LOW_RAM
+    /* A page transfer would drop the variables missing from the map */
+    if (!EEPROM_mapValid) {
+        return EEPROM_ERROR;
+    }
+#endif
+
+#ifdef EEPROM_LAZY_INIT
+    /* Complete the deferred recovery before touching the pages */
+    retStatus = EEPROM_FinishRecovery();
+    if (retStatus != EEPROM_SUCCESS) {
+        return retStatus;
+    }
+#endif
+
 #ifdef HAL_ICACHE_MODULE_ENABLED
     /* disabling ICACHE if enabled*/
     HAL_ICACHE_Disable();
@@ -612,7 +1148,9 @@ EEPROM_retStatus_t EEPROM_WriteVariable(uint16_t virtAddress, uint16_t value) {
     /* In case the EEPROM active page is full */
     if (retStatus == EEPROM_PAGE_FULL) {
         /* Perform Page transfer */
+        EEPROM_TRACE_EVENT(EEPROM_TRACE_TRANSFER_START, virtAddress);
         retStatus = EEPROM_PageTransfer(virtAddress, value);
+        EEPROM_TRACE_EVENT(EEPROM_TRACE_TRANSFER_END, retStatus);
     }
 
 #ifdef HAL_ICACHE_MODULE_ENABLED
@@ -622,3 +1160,59 @@ EEPROM_retStatus_t EEPROM_WriteVariable(uint16_t virtAddress, uint16_t value) {
     /* Return last operation status */
     return retStatus;
 }
+
+#ifdef EEPROM_ISR_QUEUE_SIZE
+EEPROM_retStatus_t EEPROM_WriteVariableFromISR(uint16_t virtAddress, uint16_t value) {
+    uint32_t head = EEPROM_queueHead;
+
+    if (virtAddress >= EEPROM_VAR_NUM) {
+        return EEPROM_ERROR;
+    }
+
+#ifndef EEPROM_ISR_QUEUE_OVERWRITE
+    /* Drop the new entry if the queue is full */
+    if ((head - EEPROM_queueTail) >= EEPROM_ISR_QUEUE_SIZE) {
+        EEPROM_queueOverflow++;
+        return EEPROM_QUEUE_FULL;
+    }
+#endif
+
+    /* Fill the slot before publishing it, volatile accesses keep the order on a single core */
+    EEPROM_queueBuffer[head & (EEPROM_ISR_QUEUE_SIZE - 1U)] = EEPROM_QUEUE_ENTRY(virtAddress, value);
+    EEPROM_queueHead = head + 1U;
+    return EEPROM_SUCCESS;
+}
+
+uint32_t EEPROM_GetQueueOverflow(void) { return EEPROM_queueOverflow; }
+#endif
+
+#ifdef EEPROM_TRACE
+uint8_t EEPROM_TraceRead(EEPROM_traceEvent_t* event) {
+    uint32_t head = 0;
+
+    while (1) {
+        head = EEPROM_traceHead;
+
+        /* Skip events already overwritten, keeping one slot of margin for the one being written */
+        if ((head - EEPROM_traceTail) >= EEPROM_TRACE_SIZE) {
+            EEPROM_traceLost += head - EEPROM_traceTail - (EEPROM_TRACE_SIZE - 1U);
+            EEPROM_traceTail = head - (EEPROM_TRACE_SIZE - 1U);
+        }
+        if (EEPROM_traceTail == head) {
+            return 0;
+        }
+
+        event->timestamp = EEPROM_traceBuffer[EEPROM_traceTail & (EEPROM_TRACE_SIZE - 1U)].timestamp;
+        event->arg = EEPROM_traceBuffer[EEPROM_traceTail & (EEPROM_TRACE_SIZE - 1U)].arg;
+        event->type = EEPROM_traceBuffer[EEPROM_traceTail & (EEPROM_TRACE_SIZE - 1U)].type;
+
+        /* Keep the event only if the producer did not start overwriting it while it was being copied */
+        if ((EEPROM_traceHead - EEPROM_traceTail) < EEPROM_TRACE_SIZE) {
+            EEPROM_traceTail++;
+            return 1;
+        }
+    }
+}
+
+uint32_t EEPROM_TraceGetLost(void) { return EEPROM_traceLost; }
+#endif
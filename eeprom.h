@@ -42,25 +42,114 @@ extern "C" {
 
 #include <stdint.h>
 #include "eepromConfig.h"
-#include "main.h"
 
 /* Macros --------------------------------------------------------------------*/
+#ifndef EEPROM_USE_STM32_BACKEND
+#define EEPROM_USE_STM32_BACKEND 1
+#endif
+
+#if EEPROM_USE_STM32_BACKEND
+#include "main.h"
+#endif
 
 /* Typedefs ------------------------------------------------------------------*/
 /*
 * EEPROM return status
 */
-typedef enum { EEPROM_SUCCESS = 0, EEPROM_ERROR = 1, EEPROM_PAGE_FULL = 2, EEPROM_NO_VALID_PAGE = 3 } EEPROM_retStatus_t;
+typedef enum { EEPROM_SUCCESS = 0, EEPROM_ERROR = 1, EEPROM_PAGE_FULL = 2, EEPROM_NO_VALID_PAGE = 3, EEPROM_QUEUE_FULL = 4 } EEPROM_retStatus_t;
+
+/*
+* Flash backend: operations and geometry of the memory holding the two pages. Addresses are backend-defined (absolute
+* for internal flash, offsets for external or file-backed memories). Programming must only clear bits with respect to
+* blankValue, as NOR flash does. A failed read aborts the current operation with an error, nothing is programmed or
+* erased based on it.
+*/
+typedef struct {
+    EEPROM_retStatus_t (*read)(uint32_t address, void* data, uint32_t size); /* Not used if isMapped */
+    EEPROM_retStatus_t (*program)(uint32_t address, uint16_t data);         /* Program one halfword */
+    EEPROM_retStatus_t (*erase)(uint32_t address);                          /* Erase the page starting at address */
+    uint32_t pageAddress[2];                                                /* Start address of Page 0 and Page 1 */
+    uint32_t pageSize;                                                      /* Size of each page, multiple of 4 */
+    uint8_t blankValue;                                                     /* Value of erased bytes */
+    uint8_t isMapped;                                                       /* 1 if pages can be read at mapOffset + address */
+    uintptr_t mapOffset;
+} EEPROM_backend_t;
+
+#ifdef EEPROM_TRACE
+/*
+* Trace event types, arg meaning is given for each of them
+*/
+typedef enum {
+    EEPROM_TRACE_PROGRAM_START = 0, /* Flash address */
+    EEPROM_TRACE_PROGRAM_END,       /* EEPROM status */
+    EEPROM_TRACE_ERASE_START,       /* Page start address */
+    EEPROM_TRACE_ERASE_END,         /* EEPROM status */
+    EEPROM_TRACE_SCAN_START,        /* Page start address */
+    EEPROM_TRACE_SCAN_END,          /* Address where the scan stopped (record found for reads), or EEPROM status for blank checks */
+    EEPROM_TRACE_FIND_PAGE,         /* Page ID selected for a write, or as source of a page transfer */
+    EEPROM_TRACE_TRANSFER_START,    /* Virtual address that triggered the transfer */
+    EEPROM_TRACE_TRANSFER_END,      /* EEPROM status */
+    EEPROM_TRACE_INIT_START,        /* Page1 status << 16 | Page0 status */
+    EEPROM_TRACE_INIT_END,          /* EEPROM status */
+    EEPROM_TRACE_RECOVERY_START,    /* Page1 status << 16 | Page0 status, deferred recovery (EEPROM_LAZY_INIT) */
+    EEPROM_TRACE_RECOVERY_END,      /* EEPROM status */
+} EEPROM_traceType_t;
+
+/*
+* Trace event
+*/
+typedef struct {
+    uint32_t timestamp; /* Cycles (DWT) or EEPROM_TRACE_TIMESTAMP() units */
+    uint32_t arg;
+    uint8_t type; /* EEPROM_traceType_t */
+} EEPROM_traceEvent_t;
+#endif
+
+/* Variables -----------------------------------------------------------------*/
+#if EEPROM_USE_STM32_BACKEND
+/*
+* STM32 internal flash backend, configured from eepromConfig.h and selected by default
+*/
+extern const EEPROM_backend_t EEPROM_backendSTM32;
+#endif
 
 /* Function prototypes -------------------------------------------------------*/
 
+/**
+ * \brief           Select the flash backend, must be called before EEPROM_Init
+ *
+ * \param[in]       backend: pointer to backend, must stay valid while in use
+ *
+ * \return          EEPROM_SUCCESS if the backend is valid, EEPROM_ERROR otherwise
+ */
+EEPROM_retStatus_t EEPROM_SetBackend(const EEPROM_backend_t* backend);
+
 /**
  * \brief           Initialize EEPROM emulation
  *
- * \return          EEPROM_SUCCESS if initialization is successful, EEPROM_ERROR otherwise
+ * \return          EEPROM_SUCCESS if initialization is successful, EEPROM_ERROR otherwise. Pages are never formatted when
+ *                  the backend fails to read them
+ *
+ * \note            With EEPROM_LAZY_INIT, only invalid page states (e.g. first boot) are repaired here. Completing an
+ *                  interrupted page transfer and erasing the stale page are left to EEPROM_Process() or to the first
+ *                  write, reads are correct in the meantime.
+ * \note            With EEPROM_LOW_RAM, writes and EEPROM_Process() fail until EEPROM_Init succeeds, since the map of
+ *                  written variables is only valid once built from readable pages.
  */
 EEPROM_retStatus_t EEPROM_Init(void);
 
+/**
+ * \brief           Perform pending maintenance work, call it when the application has time to spare
+ *
+ * \return          EEPROM_SUCCESS if all the work was done, the status of the failed operation otherwise
+ *
+ * \note            Completes the recovery deferred by EEPROM_Init with EEPROM_LAZY_INIT and writes the values queued by
+ *                  EEPROM_WriteVariableFromISR(), no action otherwise. Must be called from thread context only.
+ * \note            Queued values are released only once written: on a failed write, it and the following ones stay
+ *                  queued and are retried by the next call.
+ */
+EEPROM_retStatus_t EEPROM_Process(void);
+
 /**
  * \brief           Read variable from EEPROM emulation
  *
@@ -81,6 +170,72 @@ EEPROM_retStatus_t EEPROM_ReadVariable(uint16_t virtAddress, uint16_t* value);
  */
 EEPROM_retStatus_t EEPROM_WriteVariable(uint16_t virtAddress, uint16_t value);
 
+/**
+ * \brief           Get a pointer to the current value of a variable directly in flash
+ *
+ * \param[in]       virtAddress: virtual address of data to be accessed
+ * \param[out]      len: size in bytes of the pointed data (2 for the current 16-bit records), can be NULL
+ *
+ * \return          pointer to the value in the active page, NULL if the variable was not found or direct access is
+ *                  not supported
+ *
+ * \note            The pointer stays valid as long as EEPROM_GetGeneration() returns the same value as when it was
+ *                  obtained. A later write of the same variable leaves it pointing to the previous value.
+ * \note            Always returns NULL on families with ICACHE (HAL_ICACHE_MODULE_ENABLED), where flash must only be
+ *                  read with ICACHE disabled: use EEPROM_ReadVariable() instead.
+ */
+const void* EEPROM_GetConstPtr(uint16_t virtAddress, uint16_t* len);
+
+/**
+ * \brief           Get the flash generation counter, incremented before every page erase
+ *
+ * \return          current generation
+ */
+uint32_t EEPROM_GetGeneration(void);
+
+#ifdef EEPROM_ISR_QUEUE_SIZE
+/**
+ * \brief           Queue a variable write from interrupt context, in constant time
+ *
+ * \param[in]       virtAddress: virtual address of data to be written
+ * \param[in]       value: value to be written
+ *
+ * \return          EEPROM_SUCCESS if the write was queued, EEPROM_QUEUE_FULL if it was dropped, EEPROM_ERROR otherwise
+ *
+ * \note            The value is written at the next EEPROM_Process(), together with the other queued ones. Only the
+ *                  last value queued for a given address is written. The queue has a single producer: callers must not
+ *                  preempt each other (e.g. use it from interrupts of the same priority only).
+ */
+EEPROM_retStatus_t EEPROM_WriteVariableFromISR(uint16_t virtAddress, uint16_t value);
+
+/**
+ * \brief           Get the number of queued writes lost because the queue was full
+ *
+ * \return          Number of dropped (or overwritten, with EEPROM_ISR_QUEUE_OVERWRITE) writes
+ */
+uint32_t EEPROM_GetQueueOverflow(void);
+#endif
+
+#ifdef EEPROM_TRACE
+/**
+ * \brief           Read the oldest trace event still in the ring buffer
+ *
+ * \param[out]      event: pointer to output event
+ *
+ * \return          1 if an event was read, 0 if the buffer is empty
+ *
+ * \note            Can be called from a different context than the EEPROM functions, but from a single one
+ */
+uint8_t EEPROM_TraceRead(EEPROM_traceEvent_t* event);
+
+/**
+ * \brief           Get the number of trace events overwritten before being read
+ *
+ * \return          Number of lost events
+ */
+uint32_t EEPROM_TraceGetLost(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,12 +52,33 @@ extern "C" {
 #define EEPROM_VAR_NUM       2
 
 /* Optional parameters -------------------------------------------------------*/
+/* Build the STM32 internal flash backend and select it by default. Set to 0 for host builds, in which case the
+   mandatory parameters above other than EEPROM_VAR_NUM are not needed */
+//#define EEPROM_USE_STM32_BACKEND 1
 /* Offset between Page 0 and Page 1: if EEPROM_PAGE1_NUM is not defined, EEPROM_PAGE1_NUM = EEPROM_PAGE0_NUM + EEPROM_PAGE1_OFFSET */
 //#define EEPROM_PAGE1_OFFSET  1
 /* Address of Page 1 in memory */
 //#define EEPROM_PAGE1_ADDRESS (0x08004000 + 0x4000)
 /* Number of Page 1 in memory */
 //#define EEPROM_PAGE1_NUM     2
+/* Low-RAM mode: find the log tail by binary search and track written variables in a bitmap of EEPROM_VAR_NUM / 8 bytes */
+//#define EEPROM_LOW_RAM
+/* Number of records checked after the tail found by binary search (low-RAM mode only) */
+//#define EEPROM_TAIL_VERIFY_SLOTS 4
+/* Slot layout: each variable is appended to its own region of (EEPROM_PAGE_SIZE / 4 - 1) / EEPROM_VAR_NUM records */
+//#define EEPROM_LAYOUT_SLOTS
+/* Lazy init: defer the recovery of an interrupted transfer and the stale page erase to EEPROM_Process() or the first write */
+//#define EEPROM_LAZY_INIT
+/* Queue of EEPROM_ISR_QUEUE_SIZE entries (power of 2) for EEPROM_WriteVariableFromISR(), drained by EEPROM_Process() */
+//#define EEPROM_ISR_QUEUE_SIZE    16
+/* Overwrite the oldest queued writes when the queue is full, instead of dropping the new ones */
+//#define EEPROM_ISR_QUEUE_OVERWRITE
+/* Record timestamped flash operation events in a ring buffer of EEPROM_TRACE_SIZE entries (power of 2, 12 bytes each,
+   64 by default). To capture a whole page transfer, use the next power of 2 above 9 * EEPROM_VAR_NUM + 16 */
+//#define EEPROM_TRACE
+//#define EEPROM_TRACE_SIZE        64
+/* Timestamp source for trace events, defaults to the DWT cycle counter if available or HAL_GetTick() otherwise */
+//#define EEPROM_TRACE_TIMESTAMP() (DWT->CYCCNT)
 
 #ifdef __cplusplus
 }
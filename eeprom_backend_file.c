@@ -0,0 +1,139 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_backend_file.c
+ * \author          Andrea Vivani
+ * \brief           File-backed flash backend for EEPROM emulation on POSIX hosts
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "eeprom_backend_file.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Private variables ---------------------------------------------------------*/
+static EEPROM_backend_t EEPROM_backendFile;
+static uint8_t* EEPROM_fileImage = NULL;
+static size_t EEPROM_fileSize = 0;
+static int EEPROM_fileDescriptor = -1;
+
+/* Private functions ---------------------------------------------------------*/
+static EEPROM_retStatus_t EEPROM_FileRead(uint32_t address, void* data, uint32_t size) {
+    if (((size_t)address + size) > EEPROM_fileSize) {
+        return EEPROM_ERROR;
+    }
+    memcpy(data, EEPROM_fileImage + address, size);
+    return EEPROM_SUCCESS;
+}
+
+static EEPROM_retStatus_t EEPROM_FileProgram(uint32_t address, uint16_t data) {
+    uint16_t value;
+
+    if (((size_t)address + sizeof(value)) > EEPROM_fileSize) {
+        return EEPROM_ERROR;
+    }
+    /* NOR behavior: programming can only clear bits */
+    memcpy(&value, EEPROM_fileImage + address, sizeof(value));
+    value &= data;
+    memcpy(EEPROM_fileImage + address, &value, sizeof(value));
+    return EEPROM_SUCCESS;
+}
+
+static EEPROM_retStatus_t EEPROM_FileErase(uint32_t address) {
+    if ((address != EEPROM_backendFile.pageAddress[0]) && (address != EEPROM_backendFile.pageAddress[1])) {
+        return EEPROM_ERROR;
+    }
+    memset(EEPROM_fileImage + address, 0xFF, EEPROM_backendFile.pageSize);
+    return EEPROM_SUCCESS;
+}
+
+/* Functions -----------------------------------------------------------------*/
+
+const EEPROM_backend_t* EEPROM_FileBackendOpen(const char* path, uint32_t pageSize) {
+    struct stat fileStat;
+    size_t oldSize;
+
+    if ((EEPROM_fileImage != NULL) || (pageSize == 0) || ((pageSize % 4U) != 0)) {
+        return NULL;
+    }
+
+    EEPROM_fileDescriptor = open(path, O_RDWR | O_CREAT, 0644);
+    if (EEPROM_fileDescriptor < 0) {
+        return NULL;
+    }
+    if (fstat(EEPROM_fileDescriptor, &fileStat) != 0) {
+        goto error;
+    }
+
+    /* Extend the file to two pages, new bytes are erased */
+    oldSize = (size_t)fileStat.st_size;
+    EEPROM_fileSize = oldSize > (2U * (size_t)pageSize) ? oldSize : (2U * (size_t)pageSize);
+    if ((oldSize < EEPROM_fileSize) && (ftruncate(EEPROM_fileDescriptor, (off_t)EEPROM_fileSize) != 0)) {
+        goto error;
+    }
+    EEPROM_fileImage = mmap(NULL, EEPROM_fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, EEPROM_fileDescriptor, 0);
+    if (EEPROM_fileImage == MAP_FAILED) {
+        EEPROM_fileImage = NULL;
+        goto error;
+    }
+    if (oldSize < EEPROM_fileSize) {
+        memset(EEPROM_fileImage + oldSize, 0xFF, EEPROM_fileSize - oldSize);
+    }
+
+    EEPROM_backendFile.read = EEPROM_FileRead;
+    EEPROM_backendFile.program = EEPROM_FileProgram;
+    EEPROM_backendFile.erase = EEPROM_FileErase;
+    EEPROM_backendFile.pageAddress[0] = 0;
+    EEPROM_backendFile.pageAddress[1] = pageSize;
+    EEPROM_backendFile.pageSize = pageSize;
+    EEPROM_backendFile.blankValue = 0xFF;
+    EEPROM_backendFile.isMapped = 1;
+    EEPROM_backendFile.mapOffset = (uintptr_t)EEPROM_fileImage;
+    return &EEPROM_backendFile;
+
+error:
+    close(EEPROM_fileDescriptor);
+    EEPROM_fileDescriptor = -1;
+    return NULL;
+}
+
+void EEPROM_FileBackendClose(void) {
+    if (EEPROM_fileImage != NULL) {
+        msync(EEPROM_fileImage, EEPROM_fileSize, MS_SYNC);
+        munmap(EEPROM_fileImage, EEPROM_fileSize);
+        EEPROM_fileImage = NULL;
+    }
+    if (EEPROM_fileDescriptor >= 0) {
+        close(EEPROM_fileDescriptor);
+        EEPROM_fileDescriptor = -1;
+    }
+}
@@ -0,0 +1,69 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_backend_file.h
+ * \author          Andrea Vivani
+ * \brief           File-backed flash backend for EEPROM emulation on POSIX hosts
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EEPROM_BACKEND_FILE_H__
+#define __EEPROM_BACKEND_FILE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Includes ------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include "eeprom.h"
+
+/* Function prototypes -------------------------------------------------------*/
+
+/**
+ * \brief           Open (or create) a flash image file and map it in memory
+ *
+ * \param[in]       path: image file path. A new or shorter file is extended to two erased pages
+ * \param[in]       pageSize: size of each page, multiple of 4
+ *
+ * \return          pointer to the backend to be passed to EEPROM_SetBackend, NULL on error
+ *
+ * \note            Page 0 is at address 0 and Page 1 at address pageSize. Programming clears bits like NOR flash does.
+ */
+const EEPROM_backend_t* EEPROM_FileBackendOpen(const char* path, uint32_t pageSize);
+
+/**
+ * \brief           Flush the image to disk and unmap it
+ */
+void EEPROM_FileBackendClose(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EEPROM_BACKEND_FILE_H__ */
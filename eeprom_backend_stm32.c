@@ -0,0 +1,148 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_backend_stm32.c
+ * \author          Andrea Vivani
+ * \brief           STM32 internal flash backend for EEPROM emulation
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "eeprom.h"
+
+#if EEPROM_USE_STM32_BACKEND
+
+#include <string.h>
+#include "eeprom_STM32.h"
+
+/* Macros --------------------------------------------------------------------*/
+
+#if !defined(EEPROM_PAGE0_ADDRESS) || !defined(EEPROM_PAGE0_NUM) || !defined(EEPROM_PAGE_SIZE)
+#error "EEPROM_PAGE0_ADDRESS, EEPROM_PAGE0_NUM and EEPROM_PAGE_SIZE must be defined!"
+#endif
+
+/* Calculation of Page 1 characteristics if not explicitly defined */
+#ifndef EEPROM_PAGE1_OFFSET
+#define EEPROM_PAGE1_OFFSET ((uint32_t)1)
+#endif
+
+#ifndef EEPROM_PAGE1_ADDRESS
+#define EEPROM_PAGE1_ADDRESS ((uint32_t)EEPROM_PAGE0_ADDRESS + EEPROM_PAGE1_OFFSET * EEPROM_PAGE_SIZE)
+#endif
+
+#ifndef EEPROM_PAGE1_NUM
+#define EEPROM_PAGE1_NUM (EEPROM_PAGE0_NUM + EEPROM_PAGE1_OFFSET)
+#endif
+
+/* Memory erase struct definition */
+
+#ifdef FLASH_VOLTAGE_RANGE_3
+#define FLASH_ERASE_SET_VOLTAGE() (pEraseInit.VoltageRange = FLASH_VOLTAGE_RANGE_3)
+#else
+#define FLASH_ERASE_SET_VOLTAGE() /* No action */
+#endif
+
+#if EEPROM_ERASE == EEPROM_ERASE_PAGE_ADDRESS
+#define EEPROM_PAGE0_ID EEPROM_PAGE0_ADDRESS
+#define EEPROM_PAGE1_ID EEPROM_PAGE1_ADDRESS
+#define FLASH_ERASE_INIT(address)                                                                                                                              \
+    do {                                                                                                                                                       \
+        pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;                                                                                                          \
+        pEraseInit.PageAddress = address;                                                                                                                      \
+        pEraseInit.NbPages = 1;                                                                                                                                \
+        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
+    } while (0)
+#elif EEPROM_ERASE == EEPROM_ERASE_PAGE_NUMBER
+#define EEPROM_PAGE0_ID EEPROM_PAGE0_NUM
+#define EEPROM_PAGE1_ID EEPROM_PAGE1_NUM
+#define FLASH_ERASE_INIT(address)                                                                                                                              \
+    do {                                                                                                                                                       \
+        pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;                                                                                                          \
+        pEraseInit.Page = address;                                                                                                                             \
+        pEraseInit.NbPages = 1;                                                                                                                                \
+        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
+    } while (0)
+#else /* EEPROM_ERASE == EEPROM_ERASE_SECTOR_NUMBER */
+#define EEPROM_PAGE0_ID EEPROM_PAGE0_NUM
+#define EEPROM_PAGE1_ID EEPROM_PAGE1_NUM
+#define FLASH_ERASE_INIT(address)                                                                                                                              \
+    do {                                                                                                                                                       \
+        pEraseInit.TypeErase = FLASH_TYPEERASE_SECTORS;                                                                                                        \
+        pEraseInit.Sector = address;                                                                                                                           \
+        pEraseInit.NbSectors = 1;                                                                                                                              \
+        FLASH_ERASE_SET_VOLTAGE();                                                                                                                             \
+    } while (0)
+#endif
+
+/* Private functions ---------------------------------------------------------*/
+static EEPROM_retStatus_t EEPROM_STM32Read(uint32_t address, void* data, uint32_t size) {
+    memcpy(data, (const void*)address, size);
+    return EEPROM_SUCCESS;
+}
+
+static EEPROM_retStatus_t EEPROM_STM32Program(uint32_t address, uint16_t data) {
+    HAL_StatusTypeDef flashStatus = HAL_OK;
+
+    HAL_FLASH_Unlock();
+    flashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address, data);
+    HAL_FLASH_Lock();
+    return (flashStatus == HAL_OK) ? EEPROM_SUCCESS : EEPROM_ERROR;
+}
+
+static EEPROM_retStatus_t EEPROM_STM32Erase(uint32_t address) {
+    HAL_StatusTypeDef flashStatus = HAL_OK;
+    FLASH_EraseInitTypeDef pEraseInit;
+    uint32_t eraseError = 0;
+
+    if (address == EEPROM_PAGE0_ADDRESS) {
+        FLASH_ERASE_INIT(EEPROM_PAGE0_ID);
+    } else if (address == EEPROM_PAGE1_ADDRESS) {
+        FLASH_ERASE_INIT(EEPROM_PAGE1_ID);
+    } else {
+        return EEPROM_ERROR;
+    }
+
+    HAL_FLASH_Unlock();
+    flashStatus = HAL_FLASHEx_Erase(&pEraseInit, &eraseError);
+    HAL_FLASH_Lock();
+    return (flashStatus == HAL_OK) ? EEPROM_SUCCESS : EEPROM_ERROR;
+}
+
+/* Variables -----------------------------------------------------------------*/
+const EEPROM_backend_t EEPROM_backendSTM32 = {
+    .read = EEPROM_STM32Read,
+    .program = EEPROM_STM32Program,
+    .erase = EEPROM_STM32Erase,
+    .pageAddress = {EEPROM_PAGE0_ADDRESS, EEPROM_PAGE1_ADDRESS},
+    .pageSize = EEPROM_PAGE_SIZE,
+    .blankValue = 0xFF,
+    .isMapped = 1,
+    .mapOffset = 0,
+};
+
+#endif /* EEPROM_USE_STM32_BACKEND */
@@ -0,0 +1,80 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_format.h
+ * \author          Andrea Vivani
+ * \brief           On-flash page and record format of the EEPROM emulation
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EEPROM_FORMAT_H__
+#define __EEPROM_FORMAT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Includes ------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/* Macros --------------------------------------------------------------------*/
+/*
+* Page layout: a 16-bit status header followed by 32-bit records. The header occupies a whole record slot, so the first
+* record starts at EEPROM_FIRST_RECORD_OFFSET. Each record holds the variable value followed by its virtual address and
+* records are appended in order, so the last record of a given virtual address holds its current value.
+* All fields are little-endian halfwords.
+*/
+
+/* Page status values, stored in the first halfword of each page */
+#define EEPROM_PAGE_CLEARED          ((uint16_t)0xFFFF)
+#define EEPROM_PAGE_ACTIVE           ((uint16_t)0x0000)
+#define EEPROM_PAGE_RECEIVING        ((uint16_t)0xEEEE)
+
+/* Record layout */
+#define EEPROM_RECORD_SIZE           ((uint32_t)4)
+#define EEPROM_RECORD_VALUE_OFFSET   ((uint32_t)0)
+#define EEPROM_RECORD_ADDRESS_OFFSET ((uint32_t)2)
+#define EEPROM_RECORD_BLANK          ((uint32_t)0xFFFFFFFF)
+#define EEPROM_FIRST_RECORD_OFFSET   EEPROM_RECORD_SIZE
+
+/* Number of record slots (including the header one) in a page of the given size */
+#define EEPROM_PAGE_RECORDS(pageSize) ((uint32_t)(pageSize) / EEPROM_RECORD_SIZE)
+
+/*
+* Slot layout (EEPROM_LAYOUT_SLOTS): the records following the header are split into one region per variable, in virtual
+* address order. Records keep the same format, but a variable is only appended to its own region, so its records form a
+* prefix of the region. Records left over by the division are unused.
+*/
+#define EEPROM_SLOT_RECORDS(pageSize, varNum) ((EEPROM_PAGE_RECORDS(pageSize) - 1U) / (uint32_t)(varNum))
+#define EEPROM_SLOT_OFFSET(pageSize, varNum, virtAddress) (EEPROM_FIRST_RECORD_OFFSET + (uint32_t)(virtAddress) * EEPROM_SLOT_RECORDS(pageSize, varNum) * EEPROM_RECORD_SIZE)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EEPROM_FORMAT_H__ */
@@ -0,0 +1,56 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eepromConfig.h
+ * \author          Andrea Vivani
+ * \brief           EEPROM emulation configuration for host tools
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EEPROM_CONFIG_H__
+#define __EEPROM_CONFIG_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Mandatory parameters ------------------------------------------------------*/
+/* Number of variables stored in EEPROM, can be overridden from the command line */
+#ifndef EEPROM_VAR_NUM
+#define EEPROM_VAR_NUM           256
+#endif
+
+/* Optional parameters -------------------------------------------------------*/
+/* Host build: pages are provided by a simulated or file-backed flash */
+#define EEPROM_USE_STM32_BACKEND 0
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EEPROM_CONFIG_H__ */
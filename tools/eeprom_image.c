@@ -0,0 +1,470 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_image.c
+ * \author          Andrea Vivani
+ * \brief           Host tool to build and parse EEPROM emulation page images
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/*
+* Usage:
+*   eeprom_image build -s <page size> -n <var num> [-m log|slots] [-x <base address> [-y <page 1 address>]] [-e|-o]
+*                      <values.csv> <output>
+*   eeprom_image parse -s <page size> -n <var num> [-m log|slots] [-v] <dump.bin>
+*
+* "build" turns a CSV file of "virtAddress,value" lines into an already compacted ACTIVE page, written as raw binary or,
+* when a base address is given, as Intel HEX. With -e (default for Intel HEX) an erased Page 1 is written too, appended
+* to Page 0 in raw binary or at the page 1 address (default: base address + page size) in Intel HEX, so that programming
+* the image also clears a stale Page 1. -o writes Page 0 only. "parse" decodes a raw dump of one or more pages.
+* "-m slots" selects the layout of firmware built with EEPROM_LAYOUT_SLOTS.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eeprom_format.h"
+#include "eeprom_tools.h"
+
+/* Macros --------------------------------------------------------------------*/
+
+#define LINE_LENGTH 256
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t pageSize = 0;
+static uint32_t varNum = 0;
+static int slotLayout = 0;
+
+/* Private functions ---------------------------------------------------------*/
+static uint16_t GetHalfword(const uint8_t* image, uint32_t offset) {
+    return (uint16_t)(image[offset] | (image[offset + 1U] << 8));
+}
+
+static void SetHalfword(uint8_t* image, uint32_t offset, uint16_t value) {
+    image[offset] = (uint8_t)(value & 0xFFU);
+    image[offset + 1U] = (uint8_t)(value >> 8);
+}
+
+static uint32_t GetRecord(const uint8_t* image, uint32_t offset) {
+    return (uint32_t)GetHalfword(image, offset) | ((uint32_t)GetHalfword(image, offset + 2U) << 16);
+}
+
+/* First and last (excluded) record slot searched for a variable, the whole page in log layout */
+static void GetRecordRange(uint32_t virtAddress, uint32_t* first, uint32_t* last) {
+    if (slotLayout) {
+        *first = EEPROM_SLOT_OFFSET(pageSize, varNum, virtAddress) / EEPROM_RECORD_SIZE;
+        *last = *first + EEPROM_SLOT_RECORDS(pageSize, varNum);
+    } else {
+        *first = 1U;
+        *last = EEPROM_PAGE_RECORDS(pageSize);
+    }
+}
+
+static const char* PageStatusName(uint16_t status) {
+    switch (status) {
+        case EEPROM_PAGE_CLEARED: return "CLEARED";
+        case EEPROM_PAGE_ACTIVE: return "ACTIVE";
+        case EEPROM_PAGE_RECEIVING: return "RECEIVING";
+        default: return "INVALID";
+    }
+}
+
+static int WriteIntelHex(FILE* out, const uint8_t* image, uint32_t size, uint32_t baseAddress) {
+    uint32_t offset, ii, count, address;
+    uint8_t checksum;
+
+    for (offset = 0; offset < size; offset += count) {
+        address = baseAddress + offset;
+        /* Extended linear address record at every 64 KiB boundary */
+        if ((offset == 0) || ((address & 0xFFFFU) == 0)) {
+            checksum = (uint8_t)(0x02U + 0x04U + (address >> 24) + (address >> 16));
+            fprintf(out, ":02000004%04X%02X\n", (unsigned)(address >> 16), (unsigned)((uint8_t)(0x100U - checksum)));
+        }
+        count = (size - offset) < 16U ? (size - offset) : 16U;
+        /* Do not cross a 64 KiB boundary inside a data record */
+        if (((address & 0xFFFFU) + count) > 0x10000U) {
+            count = 0x10000U - (address & 0xFFFFU);
+        }
+        checksum = (uint8_t)(count + (address >> 8) + address);
+        fprintf(out, ":%02X%04X00", (unsigned)count, (unsigned)(address & 0xFFFFU));
+        for (ii = 0; ii < count; ii++) {
+            checksum = (uint8_t)(checksum + image[offset + ii]);
+            fprintf(out, "%02X", image[offset + ii]);
+        }
+        fprintf(out, "%02X\n", (unsigned)((uint8_t)(0x100U - checksum)));
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+static int BuildImage(const char* inputPath, const char* outputPath, int useHex, uint32_t baseAddress, int erasedPage1,
+                      uint32_t page1Address) {
+    FILE *in = NULL, *out = NULL;
+    char line[LINE_LENGTH];
+    char *text, *separator;
+    uint8_t* image = NULL;
+    uint16_t* values = NULL;
+    uint8_t* present = NULL;
+    uint32_t lineNum = 0, virtAddress, value, offset, ii, used = 0, last;
+    int ret = -1;
+
+    image = malloc(pageSize);
+    values = calloc(varNum, sizeof(*values));
+    present = calloc(varNum, sizeof(*present));
+    if ((image == NULL) || (values == NULL) || (present == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        goto exit;
+    }
+
+    in = fopen(inputPath, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", inputPath, strerror(errno));
+        goto exit;
+    }
+
+    /* Collect values, the last line of a given address wins */
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNum++;
+        text = line;
+        while ((*text == ' ') || (*text == '\t')) {
+            text++;
+        }
+        if ((*text == '#') || (*text == '\r') || (*text == '\n') || (*text == '\0')) {
+            continue;
+        }
+        separator = strchr(text, ',');
+        if (separator == NULL) {
+            fprintf(stderr, "%s:%u: expected \"virtAddress,value\"\n", inputPath, (unsigned)lineNum);
+            goto exit;
+        }
+        *separator = '\0';
+        if ((Tools_ParseNumber(text, &virtAddress) != 0) || (Tools_ParseNumber(separator + 1, &value) != 0)) {
+            fprintf(stderr, "%s:%u: invalid number\n", inputPath, (unsigned)lineNum);
+            goto exit;
+        }
+        if ((virtAddress >= varNum) || (value > 0xFFFFU)) {
+            fprintf(stderr, "%s:%u: virtual address or value out of range\n", inputPath, (unsigned)lineNum);
+            goto exit;
+        }
+        values[virtAddress] = (uint16_t)value;
+        present[virtAddress] = 1;
+    }
+
+    /* Compacted ACTIVE page: header followed by one record per variable, at the start of its region in slot layout */
+    memset(image, 0xFF, pageSize);
+    SetHalfword(image, 0, EEPROM_PAGE_ACTIVE);
+    offset = EEPROM_FIRST_RECORD_OFFSET;
+    for (ii = 0; ii < varNum; ii++) {
+        if (!present[ii]) {
+            continue;
+        }
+        if (slotLayout) {
+            GetRecordRange(ii, &offset, &last);
+            offset *= EEPROM_RECORD_SIZE;
+        }
+        if ((offset + EEPROM_RECORD_SIZE) > pageSize) {
+            fprintf(stderr, "Page too small for %u variables\n", (unsigned)varNum);
+            goto exit;
+        }
+        SetHalfword(image, offset + EEPROM_RECORD_VALUE_OFFSET, values[ii]);
+        SetHalfword(image, offset + EEPROM_RECORD_ADDRESS_OFFSET, (uint16_t)ii);
+        offset += EEPROM_RECORD_SIZE;
+        used++;
+    }
+
+    out = fopen(outputPath, useHex ? "w" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", outputPath, strerror(errno));
+        goto exit;
+    }
+    if (useHex) {
+        ret = WriteIntelHex(out, image, pageSize, baseAddress);
+    } else {
+        ret = (fwrite(image, 1, pageSize, out) == pageSize) ? 0 : -1;
+    }
+    /* Erased Page 1: an ACTIVE header left there by a previous firmware would make the first boot format both pages */
+    if ((ret == 0) && erasedPage1) {
+        memset(image, 0xFF, pageSize);
+        if (useHex) {
+            ret = WriteIntelHex(out, image, pageSize, page1Address);
+        } else {
+            ret = (fwrite(image, 1, pageSize, out) == pageSize) ? 0 : -1;
+        }
+    }
+    if ((ret == 0) && useHex) {
+        fprintf(out, ":00000001FF\n");
+        ret = ferror(out) ? -1 : 0;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+    } else {
+        printf("%u variables, %u of %u slots used\n", (unsigned)used, (unsigned)used, (unsigned)(EEPROM_PAGE_RECORDS(pageSize) - 1U));
+    }
+
+exit:
+    if (in != NULL) {
+        fclose(in);
+    }
+    if ((out != NULL) && (fclose(out) != 0)) {
+        ret = -1;
+    }
+    free(image);
+    free(values);
+    free(present);
+    return ret;
+}
+
+static void ParsePage(const uint8_t* page, uint32_t pageIndex, int verbose) {
+    uint32_t slots = EEPROM_PAGE_RECORDS(pageSize);
+    uint32_t ii, jj, offset, record, tail = 1, written = 0, torn = 0, invalid = 0, updates, first, last;
+    uint32_t fullestVar = 0, fullestUsed = 0;
+    uint16_t status, virtAddress, value;
+
+    status = GetHalfword(page, 0);
+    printf("Page %u: %s (0x%04X)\n", (unsigned)pageIndex, PageStatusName(status), status);
+
+    /* Classify records, the tail is the slot following the last written one */
+    for (ii = 1; ii < slots; ii++) {
+        offset = ii * EEPROM_RECORD_SIZE;
+        record = GetRecord(page, offset);
+        if (record == EEPROM_RECORD_BLANK) {
+            continue;
+        }
+        written++;
+        tail = ii + 1U;
+        virtAddress = GetHalfword(page, offset + EEPROM_RECORD_ADDRESS_OFFSET);
+        if (virtAddress == 0xFFFFU) {
+            torn++;
+        } else if (virtAddress >= varNum) {
+            invalid++;
+        }
+    }
+    if (slotLayout) {
+        /* Each region fills up on its own, the fullest one triggers the next page transfer */
+        for (jj = 0; jj < varNum; jj++) {
+            GetRecordRange(jj, &first, &last);
+            for (ii = first; (ii < last) && (GetRecord(page, ii * EEPROM_RECORD_SIZE) != EEPROM_RECORD_BLANK); ii++) {}
+            if ((ii - first) > fullestUsed) {
+                fullestUsed = ii - first;
+                fullestVar = jj;
+            }
+        }
+        printf("  records: %u written, %u regions of %u slots, fullest var %u with %u used\n", (unsigned)written, (unsigned)varNum,
+               (unsigned)EEPROM_SLOT_RECORDS(pageSize, varNum), (unsigned)fullestVar, (unsigned)fullestUsed);
+    } else {
+        printf("  records: %u written, %u of %u slots used (%.1f%%), %u free\n", (unsigned)written, (unsigned)(tail - 1U),
+               (unsigned)(slots - 1U), (slots > 1U) ? (100.0 * (tail - 1U) / (slots - 1U)) : 0.0, (unsigned)(slots - tail));
+        if ((written + 1U) != tail) {
+            printf("  holes: %u blank slots below the tail\n", (unsigned)(tail - 1U - written));
+        }
+    }
+    if (torn != 0) {
+        printf("  torn: %u records with value but no virtual address\n", (unsigned)torn);
+    }
+    if (invalid != 0) {
+        printf("  invalid: %u records with virtual address >= %u\n", (unsigned)invalid, (unsigned)varNum);
+    }
+
+    /* Per-variable current value and history, oldest first */
+    for (jj = 0; jj < varNum; jj++) {
+        GetRecordRange(jj, &first, &last);
+        if (!slotLayout) {
+            last = tail;
+        }
+        updates = 0;
+        value = 0;
+        for (ii = first; ii < last; ii++) {
+            offset = ii * EEPROM_RECORD_SIZE;
+            if (GetHalfword(page, offset + EEPROM_RECORD_ADDRESS_OFFSET) == jj) {
+                value = GetHalfword(page, offset + EEPROM_RECORD_VALUE_OFFSET);
+                updates++;
+            }
+        }
+        if (updates == 0) {
+            continue;
+        }
+        printf("  var %u = 0x%04X (%u) updates %u", (unsigned)jj, value, value, (unsigned)updates);
+        if (verbose) {
+            printf(" history:");
+            for (ii = first; ii < last; ii++) {
+                offset = ii * EEPROM_RECORD_SIZE;
+                if (GetHalfword(page, offset + EEPROM_RECORD_ADDRESS_OFFSET) == jj) {
+                    printf(" 0x%04X", GetHalfword(page, offset + EEPROM_RECORD_VALUE_OFFSET));
+                }
+            }
+        }
+        printf("\n");
+    }
+}
+
+static int ParseDump(const char* inputPath, int verbose) {
+    FILE* in = NULL;
+    uint8_t* page = NULL;
+    uint32_t pageIndex = 0;
+    size_t length;
+    int ret = -1;
+
+    page = malloc(pageSize);
+    if (page == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    in = fopen(inputPath, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", inputPath, strerror(errno));
+        free(page);
+        return -1;
+    }
+
+    while ((length = fread(page, 1, pageSize, in)) > 0) {
+        if (length != pageSize) {
+            fprintf(stderr, "Trailing %u bytes are not a whole page\n", (unsigned)length);
+            goto exit;
+        }
+        ParsePage(page, pageIndex++, verbose);
+    }
+    if (pageIndex == 0) {
+        fprintf(stderr, "%s is smaller than one page\n", inputPath);
+        goto exit;
+    }
+    ret = 0;
+
+exit:
+    fclose(in);
+    free(page);
+    return ret;
+}
+
+static void Usage(void) {
+    fprintf(stderr, "Usage:\n"
+                    "  eeprom_image build -s <page size> -n <var num> [-m log|slots] [-x <base address> [-y <page 1 address>]] [-e|-o]\n"
+                    "                     <values.csv> <output>\n"
+                    "  eeprom_image parse -s <page size> -n <var num> [-m log|slots] [-v] <dump.bin>\n");
+}
+
+/* Functions -----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    const char* positional[2] = {NULL, NULL};
+    uint32_t baseAddress = 0, page1Address = 0, positionalNum = 0;
+    int useHex = 0, verbose = 0, erasedPage1 = -1, page1AddressSet = 0, build, ii;
+
+    if (argc < 2) {
+        Usage();
+        return 1;
+    }
+    if (strcmp(argv[1], "build") == 0) {
+        build = 1;
+    } else if (strcmp(argv[1], "parse") == 0) {
+        build = 0;
+    } else {
+        Usage();
+        return 1;
+    }
+
+    for (ii = 2; ii < argc; ii++) {
+        if ((strcmp(argv[ii], "-s") == 0) && ((ii + 1) < argc)) {
+            if (Tools_ParseNumber(argv[++ii], &pageSize) != 0) {
+                Usage();
+                return 1;
+            }
+        } else if ((strcmp(argv[ii], "-n") == 0) && ((ii + 1) < argc)) {
+            if (Tools_ParseNumber(argv[++ii], &varNum) != 0) {
+                Usage();
+                return 1;
+            }
+        } else if ((strcmp(argv[ii], "-x") == 0) && ((ii + 1) < argc)) {
+            if (Tools_ParseNumber(argv[++ii], &baseAddress) != 0) {
+                Usage();
+                return 1;
+            }
+            useHex = 1;
+        } else if ((strcmp(argv[ii], "-y") == 0) && ((ii + 1) < argc)) {
+            if (Tools_ParseNumber(argv[++ii], &page1Address) != 0) {
+                Usage();
+                return 1;
+            }
+            page1AddressSet = 1;
+        } else if (strcmp(argv[ii], "-e") == 0) {
+            erasedPage1 = 1;
+        } else if (strcmp(argv[ii], "-o") == 0) {
+            erasedPage1 = 0;
+        } else if ((strcmp(argv[ii], "-m") == 0) && ((ii + 1) < argc)) {
+            ii++;
+            if (strcmp(argv[ii], "slots") == 0) {
+                slotLayout = 1;
+            } else if (strcmp(argv[ii], "log") == 0) {
+                slotLayout = 0;
+            } else {
+                Usage();
+                return 1;
+            }
+        } else if (strcmp(argv[ii], "-v") == 0) {
+            verbose = 1;
+        } else if ((argv[ii][0] != '-') && (positionalNum < 2)) {
+            positional[positionalNum++] = argv[ii];
+        } else {
+            Usage();
+            return 1;
+        }
+    }
+
+    if ((pageSize < (2U * EEPROM_RECORD_SIZE)) || ((pageSize % EEPROM_RECORD_SIZE) != 0) || (varNum == 0) || (varNum > 0xFFFFU)) {
+        fprintf(stderr, "Page size must be a multiple of %u and variable number in 1..65535\n", (unsigned)EEPROM_RECORD_SIZE);
+        return 1;
+    }
+    if (slotLayout && (EEPROM_SLOT_RECORDS(pageSize, varNum) == 0)) {
+        fprintf(stderr, "Page too small for one region of %u variables\n", (unsigned)varNum);
+        return 1;
+    }
+
+    if (build) {
+        if (positionalNum != 2) {
+            Usage();
+            return 1;
+        }
+        if (page1AddressSet && !useHex) {
+            Usage();
+            return 1;
+        }
+        /* Intel HEX images clear Page 1 unless told otherwise */
+        if (erasedPage1 < 0) {
+            erasedPage1 = useHex;
+        }
+        if (!page1AddressSet) {
+            page1Address = baseAddress + pageSize;
+        }
+        return (BuildImage(positional[0], positional[1], useHex, baseAddress, erasedPage1, page1Address) == 0) ? 0 : 1;
+    }
+    if (positionalNum != 1) {
+        Usage();
+        return 1;
+    }
+    return (ParseDump(positional[0], verbose) == 0) ? 0 : 1;
+}
@@ -0,0 +1,435 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_powerfail.c
+ * \author          Andrea Vivani
+ * \brief           Host power-loss fault-injection tool for the EEPROM emulation
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/*
+* Usage:
+*   eeprom_powerfail [-f <family>] [-s <page size>] [-n <variables>] [-w <writes>] [-r <workloads>] [-S <seed>] [-t]
+*                    [-e <reads per failure>] [-v]
+*
+* Runs randomized write workloads on a simulated flash and, for each of them, simulates a reset at every program and erase
+* step, EEPROM_Init included. After each reset EEPROM_Init and EEPROM_Process are run, every committed value is checked
+* after each of them (before EEPROM_Process the recovery may still be pending with EEPROM_LAZY_INIT) and the flash
+* operations, halfwords read and modeled time of the recovery are recorded, grouped by the page states found at boot. The
+* flash is always read through the backend callback so that reads, the blank checks included, are counted and timed.
+* With -t the interrupted operation is left half done instead of not being performed at all.
+* With -e reads fail at random during the boot: EEPROM_Init and
+* EEPROM_Process are retried while they fail because of an injected read failure, and no value may be lost meanwhile.
+* The exit status is nonzero if any value was lost or if recovery left work for the following boot.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eeprom.h"
+#include "eeprom_format.h"
+#include "eeprom_simflash.h"
+#include "eeprom_tools.h"
+
+/* Macros --------------------------------------------------------------------*/
+
+#define STATE_NUM          4U
+#define MAX_REPORTED_FAILS 10U
+#define MAX_BOOT_ATTEMPTS  1000U
+
+/* Typedefs ------------------------------------------------------------------*/
+typedef struct {
+    uint16_t virtAddress;
+    uint16_t value;
+} workItem_t;
+
+typedef struct {
+    uint64_t programs;
+    uint64_t maxPrograms;
+    uint64_t maxErases;
+    uint64_t maxReads;
+    double maxTimeUs;
+} bootStats_t;
+
+typedef struct {
+    uint64_t resets;
+    uint64_t failures;
+    bootStats_t init;    /* Work done by EEPROM_Init */
+    bootStats_t process; /* Work deferred to EEPROM_Process */
+} stateStats_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const SimFlash_family_t* family = NULL;
+static uint32_t pageSize = 256;
+static uint32_t varNum = 8;
+static uint32_t writeNum = 200;
+static uint8_t torn = 0;
+static uint32_t readFailOneIn = 0;
+static int verbose = 0;
+
+static workItem_t* workload = NULL;
+static uint16_t model[EEPROM_VAR_NUM];
+static uint8_t present[EEPROM_VAR_NUM];
+static jmp_buf resetPoint;
+/* Write being performed when the power was lost, -1 during the first EEPROM_Init */
+static volatile int32_t inFlight = -1;
+/* Set once a check has seen which value the interrupted write left, later checks must see the same one */
+static uint8_t inFlightSettled = 0;
+
+static stateStats_t stats[STATE_NUM][STATE_NUM];
+static uint64_t failures = 0;
+static uint64_t bootRetries = 0;
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t StateIndex(uint16_t status) {
+    switch (status) {
+        case EEPROM_PAGE_CLEARED: return 0;
+        case EEPROM_PAGE_ACTIVE: return 1;
+        case EEPROM_PAGE_RECEIVING: return 2;
+        default: return 3;
+    }
+}
+
+static const char* StateName(uint32_t index) {
+    static const char* names[STATE_NUM] = {"CLEARED", "ACTIVE", "RECEIVING", "INVALID"};
+
+    return names[index];
+}
+
+static uint16_t PageStatus(uint32_t page) {
+    const uint8_t* memory = SimFlash_GetMemory();
+
+    return (uint16_t)(memory[page * pageSize] | (memory[page * pageSize + 1U] << 8));
+}
+
+/* virtAddress is -1 for failures not related to a single variable */
+static void Fail(uint64_t resetStep, const char* message, int32_t virtAddress) {
+    if (failures < MAX_REPORTED_FAILS) {
+        printf("  reset at step %llu (write %d): %s", (unsigned long long)resetStep, (int)inFlight, message);
+        if (virtAddress >= 0) {
+            printf(", var %d", (int)virtAddress);
+        }
+        printf("\n");
+    }
+    failures++;
+}
+
+/* Runs the workload from a blank flash, returns 1 if the power was lost before its end */
+static int RunWorkload(uint64_t resetStep, int armed) {
+    const EEPROM_backend_t* backend;
+
+    SimFlash_Close();
+    backend = SimFlash_Open(pageSize, family, 0);
+    if ((backend == NULL) || (EEPROM_SetBackend(backend) != EEPROM_SUCCESS)) {
+        fprintf(stderr, "Cannot open the simulated flash\n");
+        exit(1);
+    }
+    memset(model, 0, sizeof(model));
+    memset(present, 0, sizeof(present));
+    inFlight = -1;
+    inFlightSettled = 0;
+
+    if (armed) {
+        if (setjmp(resetPoint) != 0) {
+            return 1;
+        }
+        SimFlash_SetPowerLoss(resetStep, torn, &resetPoint);
+    }
+
+    if (EEPROM_Init() != EEPROM_SUCCESS) {
+        fprintf(stderr, "EEPROM_Init failed on a blank flash\n");
+        exit(1);
+    }
+    for (inFlight = 0; inFlight < (int32_t)writeNum; inFlight++) {
+        if (EEPROM_WriteVariable(workload[inFlight].virtAddress, workload[inFlight].value) != EEPROM_SUCCESS) {
+            fprintf(stderr, "Write %d failed, the page is too small for the variables\n", (int)inFlight);
+            exit(1);
+        }
+        model[workload[inFlight].virtAddress] = workload[inFlight].value;
+        present[workload[inFlight].virtAddress] = 1;
+    }
+    SimFlash_ClearPowerLoss();
+    return 0;
+}
+
+static void CheckValues(uint64_t resetStep, const char* phase) {
+    uint16_t value = 0;
+    uint32_t ii;
+    EEPROM_retStatus_t readStatus;
+    char message[80];
+
+    for (ii = 0; ii < varNum; ii++) {
+        readStatus = EEPROM_ReadVariable((uint16_t)ii, &value);
+        /* The interrupted write may or may not have reached the flash, the value seen first becomes the committed one */
+        if (!inFlightSettled && (inFlight >= 0) && (workload[inFlight].virtAddress == ii) && (readStatus == EEPROM_SUCCESS)
+            && (value == workload[inFlight].value)) {
+            model[ii] = value;
+            present[ii] = 1;
+            continue;
+        }
+        if (present[ii] && ((readStatus != EEPROM_SUCCESS) || (value != model[ii]))) {
+            snprintf(message, sizeof(message), "%s %s", (readStatus != EEPROM_SUCCESS) ? "committed value lost" : "wrong value", phase);
+            Fail(resetStep, message, (int32_t)ii);
+            return;
+        }
+        if (!present[ii] && (readStatus == EEPROM_SUCCESS)) {
+            snprintf(message, sizeof(message), "value of a never written variable %s", phase);
+            Fail(resetStep, message, (int32_t)ii);
+            return;
+        }
+    }
+    inFlightSettled = 1;
+}
+
+/* Adds the flash work done since before to the boot statistics */
+static void AddBootStats(bootStats_t* boot, const SimFlash_stats_t* before) {
+    uint64_t programs = SimFlash_stats.programs - before->programs;
+    uint64_t erases = SimFlash_stats.erases - before->erases;
+    uint64_t reads = SimFlash_stats.reads - before->reads;
+    double timeUs = SimFlash_stats.timeUs - before->timeUs;
+
+    boot->programs += programs;
+    if (programs > boot->maxPrograms) {
+        boot->maxPrograms = programs;
+    }
+    if (erases > boot->maxErases) {
+        boot->maxErases = erases;
+    }
+    if (reads > boot->maxReads) {
+        boot->maxReads = reads;
+    }
+    if (timeUs > boot->maxTimeUs) {
+        boot->maxTimeUs = timeUs;
+    }
+}
+
+/* Runs a boot step, retrying it while it fails because of injected read failures */
+static EEPROM_retStatus_t RunBootStep(EEPROM_retStatus_t (*bootStep)(void)) {
+    EEPROM_retStatus_t retStatus = EEPROM_SUCCESS;
+    uint64_t readFailures;
+    uint32_t attempt;
+
+    for (attempt = 0; attempt < MAX_BOOT_ATTEMPTS; attempt++) {
+        readFailures = SimFlash_stats.readFailures;
+        retStatus = bootStep();
+        /* Errors without a failed read are real ones */
+        if ((retStatus == EEPROM_SUCCESS) || (SimFlash_stats.readFailures == readFailures)) {
+            break;
+        }
+        bootRetries++;
+    }
+    return retStatus;
+}
+
+static void RunResets(uint32_t workloadIndex) {
+    uint64_t steps, step, failuresBefore;
+    SimFlash_stats_t before;
+    stateStats_t* state;
+    uint32_t ii;
+
+    for (ii = 0; ii < writeNum; ii++) {
+        workload[ii].virtAddress = (uint16_t)(rand() % (int)varNum);
+        workload[ii].value = (uint16_t)rand();
+    }
+
+    /* Reference run, to count the steps */
+    RunWorkload(0, 0);
+    steps = SimFlash_stats.programs + SimFlash_stats.erases;
+    if (verbose) {
+        printf("Workload %u: %u writes, %llu reset points\n", (unsigned)workloadIndex, (unsigned)writeNum, (unsigned long long)steps);
+    }
+
+    for (step = 0; step < steps; step++) {
+        if (!RunWorkload(step, 1)) {
+            continue;
+        }
+        state = &stats[StateIndex(PageStatus(0))][StateIndex(PageStatus(1))];
+        state->resets++;
+
+        /* Boot: recovery work of EEPROM_Init, then of EEPROM_Process for the deferred part */
+        SimFlash_SetReadFailures(readFailOneIn);
+        before = SimFlash_stats;
+        if (RunBootStep(EEPROM_Init) != EEPROM_SUCCESS) {
+            SimFlash_SetReadFailures(0);
+            Fail(step, "EEPROM_Init failed", -1);
+            state->failures++;
+            continue;
+        }
+        AddBootStats(&state->init, &before);
+
+        /* With EEPROM_LAZY_INIT the recovery is still pending here, reads must be correct anyway */
+        failuresBefore = failures;
+        SimFlash_SetReadFailures(0);
+        CheckValues(step, "before EEPROM_Process");
+        SimFlash_SetReadFailures(readFailOneIn);
+
+        before = SimFlash_stats;
+        if (RunBootStep(EEPROM_Process) != EEPROM_SUCCESS) {
+            SimFlash_SetReadFailures(0);
+            Fail(step, "EEPROM_Process failed", -1);
+            state->failures++;
+            continue;
+        }
+        AddBootStats(&state->process, &before);
+        SimFlash_SetReadFailures(0);
+        CheckValues(step, "after EEPROM_Process");
+
+        /* A second boot must find nothing left to repair */
+        before = SimFlash_stats;
+        if ((EEPROM_Init() != EEPROM_SUCCESS) || (EEPROM_Process() != EEPROM_SUCCESS)
+            || (SimFlash_stats.programs != before.programs) || (SimFlash_stats.erases != before.erases)) {
+            Fail(step, "recovery not complete at the second boot", -1);
+        }
+
+        /* The store must still be writable */
+        if ((EEPROM_WriteVariable(0, 0x1234) != EEPROM_SUCCESS) || (EEPROM_ReadVariable(0, &model[0]) != EEPROM_SUCCESS)
+            || (model[0] != 0x1234)) {
+            Fail(step, "write after recovery failed", -1);
+        }
+        if (failures != failuresBefore) {
+            state->failures++;
+        }
+    }
+}
+
+static void PrintBootStats(const bootStats_t* boot, uint64_t resets) {
+    printf(" %10.1f %10llu %10llu %10llu %10.3f", (double)boot->programs / (double)resets,
+           (unsigned long long)boot->maxPrograms, (unsigned long long)boot->maxErases, (unsigned long long)boot->maxReads,
+           boot->maxTimeUs / 1000.0);
+}
+
+static void PrintReport(void) {
+    uint32_t ii, jj;
+    const stateStats_t* state;
+
+    printf("%-39s %s %s\n", "", "--------------------- EEPROM_Init --------------------",
+           "------------------- EEPROM_Process -------------------");
+    printf("%-21s %8s %8s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "boot state (P0/P1)", "resets", "failures",
+           "mean prog", "max prog", "max erase", "max reads", "max ms", "mean prog", "max prog", "max erase", "max reads",
+           "max ms");
+    for (ii = 0; ii < STATE_NUM; ii++) {
+        for (jj = 0; jj < STATE_NUM; jj++) {
+            char name[32];
+
+            state = &stats[ii][jj];
+            if (state->resets == 0) {
+                continue;
+            }
+            snprintf(name, sizeof(name), "%s/%s", StateName(ii), StateName(jj));
+            printf("%-21s %8llu %8llu", name, (unsigned long long)state->resets, (unsigned long long)state->failures);
+            PrintBootStats(&state->init, state->resets);
+            PrintBootStats(&state->process, state->resets);
+            printf("\n");
+        }
+    }
+    if (readFailOneIn != 0) {
+        printf("%llu boot steps retried after injected read failures\n", (unsigned long long)bootRetries);
+    }
+    printf("%llu failures\n", (unsigned long long)failures);
+}
+
+static void Usage(void) {
+    fprintf(stderr, "Usage:\n"
+                    "  eeprom_powerfail [-f <family>] [-s <page size>] [-n <variables>] [-w <writes>] [-r <workloads>] [-S <seed>] [-t]\n"
+                    "                   [-e <reads per failure>] [-v]\n");
+}
+
+/* Functions -----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    uint32_t workloadNum = 4, seed = 1, ii;
+
+    family = SimFlash_FindFamily("F4");
+    for (ii = 1; ii < (uint32_t)argc; ii++) {
+        uint32_t* option = NULL;
+
+        if ((strcmp(argv[ii], "-f") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            family = SimFlash_FindFamily(argv[++ii]);
+            if (family == NULL) {
+                Usage();
+                return 1;
+            }
+            continue;
+        } else if (strcmp(argv[ii], "-t") == 0) {
+            torn = 1;
+            continue;
+        } else if (strcmp(argv[ii], "-v") == 0) {
+            verbose = 1;
+            continue;
+        } else if ((strcmp(argv[ii], "-s") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &pageSize;
+        } else if ((strcmp(argv[ii], "-n") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &varNum;
+        } else if ((strcmp(argv[ii], "-w") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &writeNum;
+        } else if ((strcmp(argv[ii], "-r") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &workloadNum;
+        } else if ((strcmp(argv[ii], "-S") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &seed;
+        } else if ((strcmp(argv[ii], "-e") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            option = &readFailOneIn;
+        }
+        if ((option == NULL) || (Tools_ParseNumber(argv[++ii], option) != 0)) {
+            Usage();
+            return 1;
+        }
+    }
+    if ((varNum == 0) || (varNum > EEPROM_VAR_NUM) || (writeNum == 0) || (pageSize < (2U * EEPROM_RECORD_SIZE))
+        || ((pageSize % EEPROM_RECORD_SIZE) != 0)) {
+        fprintf(stderr, "Variables must be in 1..%u, page size a multiple of %u\n", (unsigned)EEPROM_VAR_NUM, (unsigned)EEPROM_RECORD_SIZE);
+        return 1;
+    }
+
+    workload = calloc(writeNum, sizeof(workItem_t));
+    if (workload == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    srand(seed);
+    printf("%s, page size %u, %u variables (EEPROM_VAR_NUM %u), %u workloads of %u writes, %s operations\n", family->name,
+           (unsigned)pageSize, (unsigned)varNum, (unsigned)EEPROM_VAR_NUM, (unsigned)workloadNum, (unsigned)writeNum,
+           torn ? "torn" : "skipped");
+    /* Small pages keep the sweep fast and are fine for correctness, but the modeled times only hold for real sizes */
+    if (!SimFlash_IsValidPageSize(family, pageSize)) {
+        printf("No %s part has %u-byte pages: times are indicative only\n", family->name, (unsigned)pageSize);
+    }
+    if (readFailOneIn != 0) {
+        printf("One read in %u fails during the boot\n", (unsigned)readFailOneIn);
+    }
+    for (ii = 0; ii < workloadNum; ii++) {
+        RunResets(ii);
+    }
+    PrintReport();
+
+    SimFlash_Close();
+    free(workload);
+    return (failures == 0) ? 0 : 1;
+}
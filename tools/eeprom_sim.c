@@ -0,0 +1,434 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_sim.c
+ * \author          Andrea Vivani
+ * \brief           Host tool to replay write traces against the EEPROM emulation and size it
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/*
+* Usage:
+*   eeprom_sim [-f <families>] [-s <page sizes>] [-j <jobs>] <trace.csv>
+*
+* The trace is a CSV file of "timestamp,virtAddress,value" lines, timestamps in seconds, as captured from a device
+* (`#` starts a comment). Every combination of family and page size that exists on real parts is replayed against eeprom.c on a simulated flash in
+* its own process, up to <jobs> at a time (default: all CPU cores). EEPROM_VAR_NUM is the one of the build, see
+* tools/eepromConfig.h.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "eeprom.h"
+#include "eeprom_format.h"
+#include "eeprom_simflash.h"
+#include "eeprom_tools.h"
+
+/* Macros --------------------------------------------------------------------*/
+
+#define LINE_LENGTH   256
+#define MAX_FAMILIES  16
+#define MAX_SIZES     16
+#define SECONDS_DAY   86400.0
+#define DAYS_YEAR     365.25
+
+/* Typedefs ------------------------------------------------------------------*/
+typedef struct {
+    double timestamp;
+    uint16_t virtAddress;
+    uint16_t value;
+} traceRecord_t;
+
+typedef struct {
+    const SimFlash_family_t* family;
+    uint32_t pageSize;
+} simConfig_t;
+
+typedef struct {
+    int32_t status;         /* 0 on success, -1 if the engine could not be initialized */
+    uint64_t writes;
+    uint64_t writeErrors;
+    uint64_t compactions;   /* Page erases caused by writes */
+    double worstWriteUs;
+    double totalWriteUs;
+} simResult_t;
+
+/* Private variables ---------------------------------------------------------*/
+static traceRecord_t* trace = NULL;
+static uint32_t traceLength = 0;
+
+/* Private functions ---------------------------------------------------------*/
+static int LoadTrace(const char* inputPath) {
+    char line[LINE_LENGTH];
+    uint32_t lineNum = 0, capacity = 0;
+    FILE* in = fopen(inputPath, "r");
+
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", inputPath);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char *field, *end;
+        double timestamp;
+        unsigned long virtAddress, value;
+
+        lineNum++;
+        field = strchr(line, '#');
+        if (field != NULL) {
+            *field = '\0';
+        }
+        field = line + strspn(line, " \t\r\n");
+        if (*field == '\0') {
+            continue;
+        }
+
+        timestamp = strtod(field, &end);
+        if ((end == field) || (*end != ',')) {
+            fprintf(stderr, "%s:%u: expected timestamp,virtAddress,value\n", inputPath, (unsigned)lineNum);
+            fclose(in);
+            return -1;
+        }
+        field = end + 1;
+        virtAddress = strtoul(field, &end, 0);
+        if ((end == field) || (*end != ',') || (virtAddress > 0xFFFFUL)) {
+            fprintf(stderr, "%s:%u: invalid virtual address\n", inputPath, (unsigned)lineNum);
+            fclose(in);
+            return -1;
+        }
+        field = end + 1;
+        value = strtoul(field, &end, 0);
+        if ((end == field) || (value > 0xFFFFUL)) {
+            fprintf(stderr, "%s:%u: invalid value\n", inputPath, (unsigned)lineNum);
+            fclose(in);
+            return -1;
+        }
+
+        if (traceLength == capacity) {
+            traceRecord_t* grown;
+
+            capacity = (capacity == 0) ? 1024U : (2U * capacity);
+            grown = realloc(trace, capacity * sizeof(traceRecord_t));
+            if (grown == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                fclose(in);
+                return -1;
+            }
+            trace = grown;
+        }
+        trace[traceLength].timestamp = timestamp;
+        trace[traceLength].virtAddress = (uint16_t)virtAddress;
+        trace[traceLength].value = (uint16_t)value;
+        traceLength++;
+    }
+
+    fclose(in);
+    if (traceLength == 0) {
+        fprintf(stderr, "%s: empty trace\n", inputPath);
+        return -1;
+    }
+    return 0;
+}
+
+static void RunConfig(const simConfig_t* config, simResult_t* result) {
+    const EEPROM_backend_t* backend;
+    uint32_t ii;
+
+    memset(result, 0, sizeof(simResult_t));
+    backend = SimFlash_Open(config->pageSize, config->family, 1);
+    if ((backend == NULL) || (EEPROM_SetBackend(backend) != EEPROM_SUCCESS) || (EEPROM_Init() != EEPROM_SUCCESS)) {
+        result->status = -1;
+        return;
+    }
+
+    for (ii = 0; ii < traceLength; ii++) {
+        SimFlash_stats_t before = SimFlash_stats;
+        double writeUs;
+
+        if (EEPROM_WriteVariable(trace[ii].virtAddress, trace[ii].value) != EEPROM_SUCCESS) {
+            result->writeErrors++;
+        }
+        writeUs = SimFlash_stats.timeUs - before.timeUs;
+        result->writes++;
+        result->compactions += SimFlash_stats.erases - before.erases;
+        result->totalWriteUs += writeUs;
+        if (writeUs > result->worstWriteUs) {
+            result->worstWriteUs = writeUs;
+        }
+    }
+    SimFlash_Close();
+}
+
+static int RunSweep(const simConfig_t* configs, simResult_t* results, uint32_t configNum, uint32_t jobs) {
+    pid_t* pids = calloc(configNum, sizeof(pid_t));
+    int* fds = calloc(configNum, sizeof(int));
+    uint32_t next = 0, running = 0, ii;
+    int ret = 0;
+
+    if ((pids == NULL) || (fds == NULL)) {
+        free(pids);
+        free(fds);
+        return -1;
+    }
+
+    /* Each configuration runs in its own process, so that the engine state is isolated */
+    while ((next < configNum) || (running > 0)) {
+        if ((next < configNum) && (running < jobs)) {
+            int pipeFds[2];
+
+            if (pipe(pipeFds) != 0) {
+                ret = -1;
+                break;
+            }
+            pids[next] = fork();
+            if (pids[next] == 0) {
+                simResult_t result;
+
+                close(pipeFds[0]);
+                RunConfig(&configs[next], &result);
+                _exit((write(pipeFds[1], &result, sizeof(result)) == (ssize_t)sizeof(result)) ? 0 : 1);
+            }
+            close(pipeFds[1]);
+            if (pids[next] < 0) {
+                close(pipeFds[0]);
+                ret = -1;
+                break;
+            }
+            fds[next++] = pipeFds[0];
+            running++;
+        } else {
+            int status;
+            pid_t pid = wait(&status);
+
+            if (pid < 0) {
+                ret = -1;
+                break;
+            }
+            for (ii = 0; ii < next; ii++) {
+                if (pids[ii] == pid) {
+                    /* The result is smaller than the pipe buffer, so it is already there when the child exits */
+                    if (read(fds[ii], &results[ii], sizeof(simResult_t)) != (ssize_t)sizeof(simResult_t)) {
+                        memset(&results[ii], 0, sizeof(simResult_t));
+                        results[ii].status = -1;
+                    }
+                    close(fds[ii]);
+                    running--;
+                    break;
+                }
+            }
+        }
+    }
+
+    while ((running > 0) && (wait(NULL) > 0)) {
+        running--;
+    }
+    free(pids);
+    free(fds);
+    return ret;
+}
+
+static void PrintReport(const simConfig_t* configs, const simResult_t* results, uint32_t configNum) {
+    double days = (trace[traceLength - 1U].timestamp - trace[0].timestamp) / SECONDS_DAY;
+    uint8_t used[0x10000];
+    uint32_t varUsed = 0, maxAddress = 0, ii;
+
+    memset(used, 0, sizeof(used));
+    for (ii = 0; ii < traceLength; ii++) {
+        if (!used[trace[ii].virtAddress]) {
+            used[trace[ii].virtAddress] = 1;
+            varUsed++;
+        }
+        if (trace[ii].virtAddress > maxAddress) {
+            maxAddress = trace[ii].virtAddress;
+        }
+    }
+
+    printf("Trace: %u writes over %.3f days, %u variables, EEPROM_VAR_NUM must be at least %u (built with %u)\n",
+           (unsigned)traceLength, days, (unsigned)varUsed, (unsigned)(maxAddress + 1U), (unsigned)EEPROM_VAR_NUM);
+    printf("%-6s %8s %8s %10s %12s %12s %12s %12s\n", "family", "page", "records", "compact", "compact/day", "worst ms",
+           "mean us", "years");
+
+    for (ii = 0; ii < configNum; ii++) {
+        const simResult_t* result = &results[ii];
+        uint32_t records = EEPROM_PAGE_RECORDS(configs[ii].pageSize) - 1U;
+
+        printf("%-6s %8u %8u ", configs[ii].family->name, (unsigned)configs[ii].pageSize, (unsigned)records);
+        if (result->status != 0) {
+            printf("simulation failed\n");
+            continue;
+        }
+        if (result->writeErrors > 0) {
+            printf("%llu write errors, page too small\n", (unsigned long long)result->writeErrors);
+            continue;
+        }
+        printf("%10llu ", (unsigned long long)result->compactions);
+        if ((days > 0) && (result->compactions > 0)) {
+            /* Pages are erased alternately */
+            double compactionsDay = (double)result->compactions / days;
+
+            printf("%12.3f ", compactionsDay);
+            printf("%12.3f %12.2f %12.1f\n", result->worstWriteUs / 1000.0, result->totalWriteUs / (double)result->writes,
+                   (double)configs[ii].family->endurance / (compactionsDay / 2.0) / DAYS_YEAR);
+        } else {
+            printf("%12s ", (days > 0) ? "0.000" : "n/a");
+            printf("%12.3f %12.2f %12s\n", result->worstWriteUs / 1000.0, result->totalWriteUs / (double)result->writes,
+                   (days > 0) ? "inf" : "n/a");
+        }
+    }
+}
+
+static void Usage(void) {
+    const SimFlash_family_t* family;
+
+    fprintf(stderr, "Usage:\n"
+                    "  eeprom_sim [-f <families>] [-s <page sizes>] [-j <jobs>] <trace.csv>\n"
+                    "Lists are comma separated. Families:");
+    for (family = SimFlash_families; family->name != NULL; family++) {
+        fprintf(stderr, " %s", family->name);
+    }
+    fprintf(stderr, "\n");
+}
+
+/* Functions -----------------------------------------------------------------*/
+
+int main(int argc, char** argv) {
+    const SimFlash_family_t* families[MAX_FAMILIES];
+    uint32_t pageSizes[MAX_SIZES] = {2048, 4096, 16384, 131072};
+    uint32_t familyNum = 0, sizeNum = 4, jobs = 0, configNum = 0, ii, jj;
+    int sizesGiven = 0;
+    const char* inputPath = NULL;
+    simConfig_t* configs;
+    simResult_t* results;
+    long cores;
+
+    for (ii = 1; ii < (uint32_t)argc; ii++) {
+        if ((strcmp(argv[ii], "-f") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            char* name = strtok(argv[++ii], ",");
+
+            familyNum = 0;
+            while (name != NULL) {
+                if ((familyNum == MAX_FAMILIES) || ((families[familyNum] = SimFlash_FindFamily(name)) == NULL)) {
+                    Usage();
+                    return 1;
+                }
+                familyNum++;
+                name = strtok(NULL, ",");
+            }
+        } else if ((strcmp(argv[ii], "-s") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            char* size = strtok(argv[++ii], ",");
+
+            sizeNum = 0;
+            sizesGiven = 1;
+            while (size != NULL) {
+                if ((sizeNum == MAX_SIZES) || (Tools_ParseNumber(size, &pageSizes[sizeNum]) != 0)
+                    || (pageSizes[sizeNum] < (2U * EEPROM_RECORD_SIZE)) || ((pageSizes[sizeNum] % EEPROM_RECORD_SIZE) != 0)) {
+                    Usage();
+                    return 1;
+                }
+                sizeNum++;
+                size = strtok(NULL, ",");
+            }
+        } else if ((strcmp(argv[ii], "-j") == 0) && ((ii + 1) < (uint32_t)argc)) {
+            if ((Tools_ParseNumber(argv[++ii], &jobs) != 0) || (jobs == 0)) {
+                Usage();
+                return 1;
+            }
+        } else if ((argv[ii][0] != '-') && (inputPath == NULL)) {
+            inputPath = argv[ii];
+        } else {
+            Usage();
+            return 1;
+        }
+    }
+    if ((inputPath == NULL) || (sizeNum == 0)) {
+        Usage();
+        return 1;
+    }
+    if (familyNum == 0) {
+        for (familyNum = 0; (familyNum < MAX_FAMILIES) && (SimFlash_families[familyNum].name != NULL); familyNum++) {
+            families[familyNum] = &SimFlash_families[familyNum];
+        }
+    }
+    if (jobs == 0) {
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = (cores > 0) ? (uint32_t)cores : 1U;
+    }
+
+    if (LoadTrace(inputPath) != 0) {
+        return 1;
+    }
+    for (ii = 0; ii < traceLength; ii++) {
+        if (trace[ii].virtAddress >= EEPROM_VAR_NUM) {
+            fprintf(stderr, "Virtual address %u out of range, rebuild with -DEEPROM_VAR_NUM=<number of variables>\n",
+                    (unsigned)trace[ii].virtAddress);
+            return 1;
+        }
+    }
+
+    configs = calloc(familyNum * sizeNum, sizeof(simConfig_t));
+    results = calloc(familyNum * sizeNum, sizeof(simResult_t));
+    if ((configs == NULL) || (results == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    /* Only simulate page sizes that exist in the family, the default list spans all of them */
+    for (ii = 0; ii < familyNum; ii++) {
+        for (jj = 0; jj < sizeNum; jj++) {
+            if (!SimFlash_IsValidPageSize(families[ii], pageSizes[jj])) {
+                if (sizesGiven) {
+                    fprintf(stderr, "Skipping %s with %u-byte pages: no page or sector of this size in the family\n",
+                            families[ii]->name, (unsigned)pageSizes[jj]);
+                }
+                continue;
+            }
+            configs[configNum].family = families[ii];
+            configs[configNum].pageSize = pageSizes[jj];
+            configNum++;
+        }
+    }
+    if (configNum == 0) {
+        fprintf(stderr, "No valid family and page size combination\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    if (RunSweep(configs, results, configNum, jobs) != 0) {
+        fprintf(stderr, "Cannot start the simulations\n");
+        return 1;
+    }
+    PrintReport(configs, results, configNum);
+
+    free(configs);
+    free(results);
+    free(trace);
+    return 0;
+}
@@ -0,0 +1,215 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_simflash.c
+ * \author          Andrea Vivani
+ * \brief           Simulated flash with timing model for EEPROM emulation host tools
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "eeprom_simflash.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Variables -----------------------------------------------------------------*/
+/*
+* Approximate datasheet worst-case figures (halfword programming, single page/sector erase at 2.7-3.6 V), reads at the
+* maximum clock with the required wait states and no cache or prefetch. Page sizes list the erase units of all the lines
+* of each family (e.g. F1 low/medium vs high density, L4 vs L4+, H7A3/B0 vs other H7), sectors of any size can be used.
+* Adjust them to the exact part number when sizing a product.
+*/
+const SimFlash_family_t SimFlash_families[] = {
+    {"F1", {1024, 2048}, 0.042, 70.0, 40000.0, 0.0, 10000},
+    {"F4", {16384, 65536, 131072}, 0.036, 100.0, 300000.0, 13000.0, 10000},
+    {"F7", {16384, 32768, 65536, 131072, 262144}, 0.032, 100.0, 300000.0, 13000.0, 10000},
+    {"G0", {2048}, 0.047, 90.0, 40000.0, 0.0, 10000},
+    {"G4", {2048, 4096}, 0.035, 90.0, 24500.0, 0.0, 10000},
+    {"L4", {2048, 4096, 8192}, 0.050, 90.0, 24500.0, 0.0, 10000},
+    {"H7", {8192, 131072}, 0.020, 120.0, 1000000.0, 23000.0, 10000},
+    {NULL, {0}, 0.0, 0.0, 0.0, 0.0, 0},
+};
+
+SimFlash_stats_t SimFlash_stats;
+
+/* Private variables ---------------------------------------------------------*/
+static EEPROM_backend_t SimFlash_backend;
+static const SimFlash_family_t* SimFlash_family = NULL;
+static uint8_t* SimFlash_memory = NULL;
+static double SimFlash_eraseUs = 0;
+static jmp_buf* SimFlash_resetPoint = NULL;
+static uint64_t SimFlash_opsLeft = 0;
+static uint8_t SimFlash_torn = 0;
+static uint32_t SimFlash_readFailOneIn = 0;
+
+/* Private functions ---------------------------------------------------------*/
+/* Returns 1 if the power is lost before the current operation completes */
+static int SimFlash_PowerLost(void) {
+    if (SimFlash_resetPoint == NULL) {
+        return 0;
+    }
+    if (SimFlash_opsLeft == 0) {
+        return 1;
+    }
+    SimFlash_opsLeft--;
+    return 0;
+}
+
+static void SimFlash_Reset(void) {
+    jmp_buf* resetPoint = SimFlash_resetPoint;
+
+    SimFlash_resetPoint = NULL;
+    longjmp(*resetPoint, 1);
+}
+
+static EEPROM_retStatus_t SimFlash_Read(uint32_t address, void* data, uint32_t size) {
+    if ((address + size) > (2U * SimFlash_backend.pageSize)) {
+        return EEPROM_ERROR;
+    }
+    SimFlash_stats.reads += size / 2U;
+    SimFlash_stats.timeUs += SimFlash_family->readUs * (double)(size / 2U);
+    if ((SimFlash_readFailOneIn != 0) && ((rand() % SimFlash_readFailOneIn) == 0)) {
+        memset(data, (rand() & 1) ? 0xFF : 0x00, size);
+        SimFlash_stats.readFailures++;
+        return EEPROM_ERROR;
+    }
+    memcpy(data, SimFlash_memory + address, size);
+    return EEPROM_SUCCESS;
+}
+
+static EEPROM_retStatus_t SimFlash_Program(uint32_t address, uint16_t data) {
+    uint16_t value;
+
+    if ((address + sizeof(value)) > (2U * SimFlash_backend.pageSize)) {
+        return EEPROM_ERROR;
+    }
+    /* NOR behavior: programming can only clear bits */
+    memcpy(&value, SimFlash_memory + address, sizeof(value));
+    if (SimFlash_PowerLost()) {
+        if (SimFlash_torn) {
+            /* Only some of the bits to be cleared are */
+            value &= (uint16_t)(data | (uint16_t)rand());
+            memcpy(SimFlash_memory + address, &value, sizeof(value));
+        }
+        SimFlash_Reset();
+    }
+    value &= data;
+    memcpy(SimFlash_memory + address, &value, sizeof(value));
+    SimFlash_stats.programs++;
+    SimFlash_stats.timeUs += SimFlash_family->programUs;
+    return EEPROM_SUCCESS;
+}
+
+static EEPROM_retStatus_t SimFlash_Erase(uint32_t address) {
+    if ((address != SimFlash_backend.pageAddress[0]) && (address != SimFlash_backend.pageAddress[1])) {
+        return EEPROM_ERROR;
+    }
+    if (SimFlash_PowerLost()) {
+        if (SimFlash_torn) {
+            uint32_t ii;
+
+            /* Only some of the bits are set */
+            for (ii = 0; ii < SimFlash_backend.pageSize; ii++) {
+                SimFlash_memory[address + ii] |= (uint8_t)rand();
+            }
+        }
+        SimFlash_Reset();
+    }
+    memset(SimFlash_memory + address, 0xFF, SimFlash_backend.pageSize);
+    SimFlash_stats.erases++;
+    SimFlash_stats.timeUs += SimFlash_eraseUs;
+    return EEPROM_SUCCESS;
+}
+
+/* Functions -----------------------------------------------------------------*/
+
+const SimFlash_family_t* SimFlash_FindFamily(const char* name) {
+    const SimFlash_family_t* family;
+
+    for (family = SimFlash_families; family->name != NULL; family++) {
+        if (strcmp(family->name, name) == 0) {
+            return family;
+        }
+    }
+    return NULL;
+}
+
+uint8_t SimFlash_IsValidPageSize(const SimFlash_family_t* family, uint32_t pageSize) {
+    uint32_t ii;
+
+    for (ii = 0; (ii < SIMFLASH_PAGE_SIZES) && (family->pageSizes[ii] != 0); ii++) {
+        if (family->pageSizes[ii] == pageSize) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const EEPROM_backend_t* SimFlash_Open(uint32_t pageSize, const SimFlash_family_t* family, uint8_t mapped) {
+    if ((SimFlash_memory != NULL) || (family == NULL) || (pageSize == 0) || ((pageSize % 4U) != 0)) {
+        return NULL;
+    }
+    SimFlash_memory = malloc(2U * (size_t)pageSize);
+    if (SimFlash_memory == NULL) {
+        return NULL;
+    }
+    memset(SimFlash_memory, 0xFF, 2U * (size_t)pageSize);
+    memset(&SimFlash_stats, 0, sizeof(SimFlash_stats));
+
+    SimFlash_family = family;
+    SimFlash_eraseUs = family->eraseBaseUs + family->erasePerKBUs * (pageSize / 1024.0);
+
+    SimFlash_backend.read = SimFlash_Read;
+    SimFlash_backend.program = SimFlash_Program;
+    SimFlash_backend.erase = SimFlash_Erase;
+    SimFlash_backend.pageAddress[0] = 0;
+    SimFlash_backend.pageAddress[1] = pageSize;
+    SimFlash_backend.pageSize = pageSize;
+    SimFlash_backend.blankValue = 0xFF;
+    SimFlash_backend.isMapped = mapped;
+    SimFlash_backend.mapOffset = mapped ? (uintptr_t)SimFlash_memory : 0;
+    SimFlash_readFailOneIn = 0;
+    return &SimFlash_backend;
+}
+
+void SimFlash_Close(void) {
+    free(SimFlash_memory);
+    SimFlash_memory = NULL;
+}
+
+uint8_t* SimFlash_GetMemory(void) { return SimFlash_memory; }
+
+void SimFlash_SetPowerLoss(uint64_t opCount, uint8_t torn, jmp_buf* resetPoint) {
+    SimFlash_opsLeft = opCount;
+    SimFlash_torn = torn;
+    SimFlash_resetPoint = resetPoint;
+}
+
+void SimFlash_ClearPowerLoss(void) { SimFlash_resetPoint = NULL; }
+
+void SimFlash_SetReadFailures(uint32_t oneIn) { SimFlash_readFailOneIn = oneIn; }
@@ -0,0 +1,158 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_simflash.h
+ * \author          Andrea Vivani
+ * \brief           Simulated flash with timing model for EEPROM emulation host tools
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EEPROM_SIMFLASH_H__
+#define __EEPROM_SIMFLASH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Includes ------------------------------------------------------------------*/
+
+#include <setjmp.h>
+#include <stdint.h>
+#include "eeprom.h"
+
+/* Macros --------------------------------------------------------------------*/
+
+#define SIMFLASH_PAGE_SIZES 6 /* Maximum number of erase unit sizes of a family */
+
+/* Typedefs ------------------------------------------------------------------*/
+/*
+* Flash timing and endurance model of a microcontroller family
+*/
+typedef struct {
+    const char* name;
+    uint32_t pageSizes[SIMFLASH_PAGE_SIZES]; /* Page/sector sizes found in the family, 0-terminated if fewer */
+    double readUs;       /* CPU time to read one halfword from flash, wait states included */
+    double programUs;    /* Worst-case time to program one halfword */
+    double eraseBaseUs;  /* Worst-case erase time: eraseBaseUs + erasePerKBUs * page size in KiB */
+    double erasePerKBUs;
+    uint32_t endurance;  /* Guaranteed erase cycles per page */
+} SimFlash_family_t;
+
+/*
+* Flash operation counters and modeled time
+*/
+typedef struct {
+    uint64_t reads;        /* Halfwords read through the backend, only counted if not mapped */
+    uint64_t programs;
+    uint64_t erases;
+    uint64_t readFailures; /* Backend reads failed on purpose, see SimFlash_SetReadFailures() */
+    double timeUs;
+} SimFlash_stats_t;
+
+/* Variables -----------------------------------------------------------------*/
+extern const SimFlash_family_t SimFlash_families[];
+extern SimFlash_stats_t SimFlash_stats;
+
+/* Function prototypes -------------------------------------------------------*/
+
+/**
+ * \brief           Find a family timing model by name
+ *
+ * \param[in]       name: family name, e.g. "F4"
+ *
+ * \return          pointer to the family model, NULL if not found
+ */
+const SimFlash_family_t* SimFlash_FindFamily(const char* name);
+
+/**
+ * \brief           Check whether a page size is an erase unit of a family
+ *
+ * \param[in]       family: family timing model
+ * \param[in]       pageSize: size of each page
+ *
+ * \return          1 if some part of the family has pages or sectors of this size, 0 otherwise
+ */
+uint8_t SimFlash_IsValidPageSize(const SimFlash_family_t* family, uint32_t pageSize);
+
+/**
+ * \brief           Allocate an erased simulated flash of two pages
+ *
+ * \param[in]       pageSize: size of each page, multiple of 4
+ * \param[in]       family: timing model used to accumulate SimFlash_stats.timeUs
+ * \param[in]       mapped: if 1 the engine reads the memory directly, otherwise through the backend read callback, which
+ *                  is slower but can fail on purpose
+ *
+ * \return          pointer to the backend to be passed to EEPROM_SetBackend, NULL on error
+ *
+ * \note            Reads are only counted and timed when the flash is not mapped, since direct accesses by the engine cannot
+ *                  be observed. Program and erase operations are always accounted for.
+ */
+const EEPROM_backend_t* SimFlash_Open(uint32_t pageSize, const SimFlash_family_t* family, uint8_t mapped);
+
+/**
+ * \brief           Free the simulated flash
+ */
+void SimFlash_Close(void);
+
+/**
+ * \brief           Get a pointer to the simulated flash content, 2 * pageSize bytes
+ *
+ * \return          pointer to the flash content, NULL if not open
+ */
+uint8_t* SimFlash_GetMemory(void);
+
+/**
+ * \brief           Arm a simulated power loss
+ *
+ * \param[in]       opCount: number of program/erase operations completed before the power loss
+ * \param[in]       torn: if 0 the interrupted operation has no effect, otherwise it is left half done (random bits of the
+ *                  halfword programmed, random bits of the page erased)
+ * \param[in]       resetPoint: jump buffer the interrupted operation longjmps to with value 1
+ */
+void SimFlash_SetPowerLoss(uint64_t opCount, uint8_t torn, jmp_buf* resetPoint);
+
+/**
+ * \brief           Disarm the simulated power loss
+ */
+void SimFlash_ClearPowerLoss(void);
+
+/**
+ * \brief           Make backend reads fail at random
+ *
+ * \param[in]       oneIn: average number of reads per failure, 0 to disable
+ *
+ * \note            Only reads through the read callback can fail, so the flash must be opened with mapped = 0. A failed
+ *                  read returns EEPROM_ERROR and fills the buffer with either all-0 or all-1 bits, which look like valid
+ *                  page states and blank records.
+ */
+void SimFlash_SetReadFailures(uint32_t oneIn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EEPROM_SIMFLASH_H__ */
@@ -0,0 +1,59 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_tools.c
+ * \author          Andrea Vivani
+ * \brief           Helpers shared by the EEPROM emulation host tools
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "eeprom_tools.h"
+#include <errno.h>
+#include <stdlib.h>
+
+/* Functions -----------------------------------------------------------------*/
+
+int Tools_ParseNumber(const char* text, uint32_t* value) {
+    char* end = NULL;
+    unsigned long parsed;
+
+    errno = 0;
+    parsed = strtoul(text, &end, 0);
+    if ((errno != 0) || (end == text) || (parsed > 0xFFFFFFFFUL)) {
+        return -1;
+    }
+    while ((*end == ' ') || (*end == '\t') || (*end == '\r') || (*end == '\n')) {
+        end++;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+    *value = (uint32_t)parsed;
+    return 0;
+}
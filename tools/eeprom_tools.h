@@ -0,0 +1,61 @@
+/* BEGIN Header */
+/**
+ ******************************************************************************
+ * \file            eeprom_tools.h
+ * \author          Andrea Vivani
+ * \brief           Helpers shared by the EEPROM emulation host tools
+ ******************************************************************************
+ * \copyright
+ *
+ * Copyright 2024 Andrea Vivani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ ******************************************************************************
+ */
+/* END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EEPROM_TOOLS_H__
+#define __EEPROM_TOOLS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Includes ------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/* Function prototypes -------------------------------------------------------*/
+
+/**
+ * \brief           Parse an unsigned 32-bit number
+ *
+ * \param[in]       text: decimal, hexadecimal (0x prefix) or octal (0 prefix) number, trailing whitespace allowed
+ * \param[out]      value: parsed number, unchanged on error
+ *
+ * \return          0 on success, -1 if the text is not a number or does not fit in 32 bits
+ */
+int Tools_ParseNumber(const char* text, uint32_t* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EEPROM_TOOLS_H__ */